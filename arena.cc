@@ -0,0 +1,36 @@
+/* File: arena.cc
+ * --------------
+ * Implementation of the Arena class.
+ */
+
+#include "arena.h"
+#include "context.h"
+
+Arena::Arena() : numNodes(0), numLists(0), bytesRequested(0) {
+}
+
+Arena::~Arena() {
+    // in reverse, as destructors would run for objects on the heap
+    for (size_t i = cleanups.size(); i > 0; i--)
+        cleanups[i-1].first(cleanups[i-1].second);
+}
+
+void *Arena::Allocate(size_t size, size_t alignment) {
+    bytesRequested += size;
+    return allocator.Allocate(size, alignment);
+}
+
+void Arena::AddCleanup(void (*fn)(void *), void *object) {
+    cleanups.push_back(std::make_pair(fn, object));
+}
+
+void Arena::PrintStats(FILE *fp) const {
+    fprintf(fp, "arena: %d nodes, %d lists, %zu bytes in %zu bytes of slabs\n",
+            numNodes, numLists, bytesRequested,
+            (size_t)allocator.getTotalMemory());
+}
+
+Arena *CurrentArena() {
+    CompilationContext *ctx = CompilationContext::Current();
+    return ctx ? ctx->GetArena() : NULL;
+}
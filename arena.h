@@ -0,0 +1,55 @@
+/* File: arena.h
+ * -------------
+ * This file defines the bump allocator that the parse tree lives in.
+ * Every node and list that the parser builds is carved out of the Arena
+ * of the compilation creating it (a thin cover of
+ * llvm::BumpPtrAllocator), and the whole tree is released
+ * in one shot when the CompilationContext is destroyed. Nothing in the
+ * tree is ever deleted on its own.
+ *
+ * Nodes have no destructors worth running, but Lists own the storage of
+ * their elements, so each List registers itself on the cleanup list of
+ * the arena and is destroyed before the memory is released.
+ *
+ * Objects created outside of a compilation (the Type singletons, built
+ * during static initialization) come from the regular heap and live as
+ * long as the process.
+ */
+
+#ifndef _H_arena
+#define _H_arena
+
+#include <stdio.h>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "llvm/Support/Allocator.h"
+
+class Arena
+{
+  public:
+    Arena();
+    ~Arena();   // runs the cleanups, then releases every slab at once
+
+    void *Allocate(size_t size, size_t alignment);
+
+    // fn(object) is called when the arena is released
+    void AddCleanup(void (*fn)(void *), void *object);
+
+    // Statistics, printed to stderr with -d arena
+    void CountNode() { numNodes++; }
+    void CountList() { numLists++; }
+    void PrintStats(FILE *fp) const;
+
+  private:
+    llvm::BumpPtrAllocator allocator;
+    std::vector<std::pair<void (*)(void *), void *> > cleanups;
+    int numNodes, numLists;
+    size_t bytesRequested;
+};
+
+// The arena of the compilation running on the calling thread, NULL if
+// there is none
+Arena *CurrentArena();
+
+#endif
@@ -5,23 +5,29 @@
 #include "ast.h"
 #include "ast_type.h"
 #include "ast_decl.h"
-#include "symtable.h"
+#include "arena.h"
+#include "context.h"
 #include <string.h> // strdup
 #include <stdio.h>  // printf
 
-Symtable *Node::symtable = new Symtable();
-IRGenerator *Node::irgen = new IRGenerator();
-
 Node::Node(yyltype loc) {
-    location = new yyltype(loc);
+    location = loc;
     parent = NULL;
 }
 
 Node::Node() {
-    location = NULL;
+    location.begin = location.end = NoLoc;
     parent = NULL;
 }
 
+void *Node::operator new(size_t size) {
+    Arena *arena = CurrentArena();
+    if (arena == NULL)
+        return ::operator new(size);
+    arena->CountNode();
+    return arena->Allocate(size, alignof(std::max_align_t));
+}
+
 /* The Print method is used to print the parse tree nodes.
  * If this node has a location (most nodes do, but some do not), it
  * will first print the line number to help you match the parse tree 
@@ -33,8 +39,9 @@ Node::Node() {
 void Node::Print(int indentLevel, const char *label) { 
     const int numSpaces = 3;
     printf("\n");
-    if (GetLocation()) 
-        printf("%*d", numSpaces, GetLocation()->first_line);
+    CompilationContext *ctx = CompilationContext::Current();
+    if (GetLocation() && ctx)
+        printf("%*d", numSpaces, ctx->LineOf(location.begin));
     else 
         printf("%*s", numSpaces, "");
     printf("%*s%s%s: ", indentLevel*numSpaces, "", 
@@ -42,10 +49,10 @@ void Node::Print(int indentLevel, const char *label) {
    PrintChildren(indentLevel);
 } 
 	 
-Identifier::Identifier(yyltype loc, const char *n) : Node(loc) {
-    name = strdup(n);
+Identifier::Identifier(yyltype loc, Atom n) : Node(loc) {
+    name = n;
 } 
 
 void Identifier::PrintChildren(int indentLevel) {
-    printf("%s", name);
+    printf("%s", name.name);
 }
@@ -7,10 +7,11 @@
  * more correctly, of instances of concrete subclassses such as VarDecl,
  * ForStmt, and AssignExpr).
  * 
- * Location: Each node maintains its lexical location (line and columns in 
- * file), that location can be NULL for those nodes that don't care/use 
- * locations. The location is typcially set by the node constructor.  The 
- * location is used to provide the context when reporting semantic errors.
+ * Location: Each node maintains its lexical location (the source offsets
+ * of its first and last character, see location.h), that location can be
+ * NULL for those nodes that don't care/use locations. The location is
+ * typcially set by the node constructor.  The location is used to provide
+ * the context when reporting semantic errors.
  *
  * Parent: Each node has a pointer to its parent. For a Program node, the 
  * parent is NULL, for all other nodes it is the pointer to the node one level
@@ -39,6 +40,7 @@
 
 #include <stdlib.h>   // for NULL
 #include "location.h"
+#include "atom.h"
 #include <iostream>
 #include "irgen.h"
 
@@ -48,21 +50,24 @@ class SymbolTable;
 class MyStack;
 class FnDecl;
 class Symtable;
+class CompilationContext;
 
 class Node  {
   protected:
-    yyltype *location;
+    yyltype location;     // begin is NoLoc if the node has none
     Node *parent;
 
   public:
-    static Symtable* symtable;
-    static IRGenerator* irgen;
-
     Node(yyltype loc);
     Node();
     virtual ~Node() {}
+
+    // Nodes are allocated in the arena of the current compilation (see
+    // arena.h) and released with it, so delete does nothing
+    static void *operator new(size_t size);
+    static void operator delete(void *p) {}
     
-    yyltype *GetLocation()   { return location; }
+    yyltype *GetLocation()   { return location.begin == NoLoc ? NULL : &location; }
     void SetParent(Node *p)  { parent = p; }
     Node *GetParent()        { return parent; }
 
@@ -73,21 +78,27 @@ class Node  {
     void Print(int indentLevel, const char *label = NULL); 
     virtual void PrintChildren(int indentLevel)  {}
 
-    virtual llvm::Value* Emit() { return NULL; }
+    // Semantic analysis, run over the whole tree before Emit: binds every
+    // use of a variable to its declaration and gives every expression its
+    // type (see Program::Resolve)
+    virtual void Resolve(CompilationContext *ctx) {}
+
+    virtual llvm::Value* Emit(CompilationContext *ctx) { return NULL; }
 };
    
 
 class Identifier : public Node 
 {
   protected:
-    char *name;
+    Atom name;
     
   public:
-    Identifier(yyltype loc, const char *name);
+    Identifier(yyltype loc, Atom name);
     const char *GetPrintNameForNode()   { return "Identifier"; }
-    char *GetName() const { return name; }
+    const char *GetName() const { return name.name; }
+    Atom GetAtom() const { return name; }
     void PrintChildren(int indentLevel);
-    friend ostream& operator<<(ostream& out, Identifier *id) { return out << id->name; }
+    friend ostream& operator<<(ostream& out, Identifier *id) { return out << id->name.name; }
 };
 
 
@@ -5,34 +5,58 @@
 #include "ast_decl.h"
 #include "ast_type.h"
 #include "ast_stmt.h"
-#include "symtable.h"        
+#include "ast_expr.h"
+#include "errors.h"
+#include "symtable.h"
+#include "context.h"
+#include "timing.h"
          
 Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
     Assert(n != NULL);
     (id=n)->SetParent(this); 
 }
 
+/* Types and type qualifiers are not reparented: the built-in ones are
+ * singletons shared by every compilation.
+ */
 VarDecl::VarDecl(Identifier *n, Type *t, Expr *e) : Decl(n) {
     Assert(n != NULL && t != NULL);
-    (type=t)->SetParent(this);
+    type = t;
+    assignTo = NULL;
     if (e) (assignTo=e)->SetParent(this);
     typeq = NULL;
+    isGlobal = false;
+    storage = NULL;
+    inSSA = false;
 }
 
 VarDecl::VarDecl(Identifier *n, TypeQualifier *tq, Expr *e) : Decl(n) {
     Assert(n != NULL && tq != NULL);
-    (typeq=tq)->SetParent(this);
+    typeq = tq;
+    assignTo = NULL;
     if (e) (assignTo=e)->SetParent(this);
     type = NULL;
+    isGlobal = false;
+    storage = NULL;
+    inSSA = false;
 }
 
 VarDecl::VarDecl(Identifier *n, Type *t, TypeQualifier *tq, Expr *e) : Decl(n) {
     Assert(n != NULL && t != NULL && tq != NULL);
-    (type=t)->SetParent(this);
-    (typeq=tq)->SetParent(this);
+    type = t;
+    typeq = tq;
+    assignTo = NULL;
     if (e) (assignTo=e)->SetParent(this);
+    isGlobal = false;
+    storage = NULL;
+    inSSA = false;
 }
   
+// the error productions of the parser report what they stand for
+VarDeclError::VarDeclError() : VarDecl() {
+    ReportError::Formatted(NULL, "%s", GetPrintNameForNode());
+}
+
 void VarDecl::PrintChildren(int indentLevel) { 
    if (typeq) typeq->Print(indentLevel+1);
    if (type) type->Print(indentLevel+1);
@@ -40,14 +64,42 @@ void VarDecl::PrintChildren(int indentLevel) {
    if (assignTo) assignTo->Print(indentLevel+1, "(initializer) ");
 }
 
-llvm::Value* VarDecl::Emit() {
+/* The initializer is resolved before the name is declared, so in
+ * "int x = x;" the x on the right is the outer one. A name declared twice
+ * in one scope is reported and keeps its first declaration.
+ */
+void VarDecl::Resolve(CompilationContext *ctx) {
+  Symtable *symtable = ctx->GetSymtable();
+  if (assignTo) {
+    assignTo->Resolve(ctx);
+    Type *given = assignTo->GetType();
+    if (type && !given->IsError() && !type->IsEquivalentTo(given))
+      ReportError::InvalidInitialization(this->id, type, given);
+  }
+  isGlobal = (symtable->GetCurrentIndex() == 0);
+  if (VarDecl *prev = symtable->LookupInScope(this->id->GetAtom()))
+    ReportError::DeclConflict(this, prev);
+  else
+    symtable->Insert(this->id->GetAtom(), this);
+}
+
+bool VarDecl::PlaceInSSA(IRGenerator *irgen) {
+  inSSA = irgen->BuildsSSA() && !isGlobal && type != NULL &&
+          type->GetTag() != TypeArray;
+  return inSSA;
+}
+
+/* A local built as SSA values has no storage: its initializer, or undef
+ * if it has none, is its first definition.
+ */
+llvm::Value* VarDecl::Emit(CompilationContext *ctx) {
+  IRGenerator *irgen = ctx->GetIRGenerator();
   //std::cout << "VarDecl" << std::endl;
   llvm::Type *type = irgen->GetType(this->type);
-  
-  llvm::Twine *name = new llvm::Twine(this->id->GetName());
+  const char *name = this->id->GetName();
   
   // its a global variable 
-  if (symtable->GetCurrentIndex() == 0) 
+  if (isGlobal) 
   {
     /* global variable
      * Module
@@ -61,52 +113,64 @@ llvm::Value* VarDecl::Emit() {
      */
     if (assignTo) {
       
-      llvm::Value *ret = assignTo->Emit();
+      // the builder folds a constant initializer into a Constant
+      llvm::Value *ret = assignTo->Emit(ctx);
       llvm::Constant* c = llvm::Constant::getNullValue(type);
-      if (dynamic_cast<llvm::Constant*>(ret)) {
-        c = dynamic_cast<llvm::Constant*>(ret);
+      if (llvm::isa<llvm::Constant>(ret)) {
+        c = llvm::cast<llvm::Constant>(ret);
       }
       llvm::GlobalVariable *global = new llvm::GlobalVariable(
       *(irgen->GetOrCreateModule(this->id->GetName())), type, false, 
       llvm::GlobalValue::ExternalLinkage, c,
-      *name, NULL);
-      symtable->Insert(this->id->GetName(), global); 
+      name, NULL);
+      storage = global; 
    
     }
     else {
       llvm::Constant* c = llvm::Constant::getNullValue(type);
       llvm::GlobalVariable *global = new llvm::GlobalVariable(
       *(irgen->GetOrCreateModule(this->id->GetName())), type, false,
-      llvm::GlobalValue::ExternalLinkage, c, *name, NULL);
-      symtable->Insert(this->id->GetName(), global);
+      llvm::GlobalValue::ExternalLinkage, c, name, NULL);
+      storage = global;
     } 
   }
+  else if (PlaceInSSA(irgen))
+  {
+    llvm::Value *value = assignTo ? assignTo->Emit(ctx) : llvm::UndefValue::get(type);
+    irgen->WriteVariable(this, value);
+  }
   else
   { 
-    const llvm::Twine *name = new llvm::Twine(this->id->GetName());
-    llvm::BasicBlock *bb = irgen->GetBasicBlock();
-    llvm::AllocaInst *allo = new llvm::AllocaInst(type,*name, bb);
-    symtable->Insert(this->id->GetName(),allo);
+    storage = irgen->CreateEntryAlloca(type, name);
+    irgen->StartLifetime(storage);
+    if (assignTo)
+      irgen->GetBuilder().CreateStore(assignTo->Emit(ctx), storage);
   }
   return NULL;
 }
 
 FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(n) {
     Assert(n != NULL && r!= NULL && d != NULL);
-    (returnType=r)->SetParent(this);
+    returnType = r;
     (formals=d)->SetParentAll(this);
+    formals->ShrinkToFit();
     body = NULL;
     returnTypeq = NULL;
 }
 
 FnDecl::FnDecl(Identifier *n, Type *r, TypeQualifier *rq, List<VarDecl*> *d) : Decl(n) {
     Assert(n != NULL && r != NULL && rq != NULL&& d != NULL);
-    (returnType=r)->SetParent(this);
-    (returnTypeq=rq)->SetParent(this);
+    returnType = r;
+    returnTypeq = rq;
     (formals=d)->SetParentAll(this);
+    formals->ShrinkToFit();
     body = NULL;
 }
 
+FormalsError::FormalsError() : FnDecl() {
+    ReportError::Formatted(NULL, "%s", GetPrintNameForNode());
+}
+
 void FnDecl::SetFunctionBody(Stmt *b) { 
     (body=b)->SetParent(this);
 }
@@ -118,49 +182,67 @@ void FnDecl::PrintChildren(int indentLevel) {
     if (body) body->Print(indentLevel+1, "(body) ");
 }
 
-llvm::Value* FnDecl::Emit() {
+void FnDecl::Resolve(CompilationContext *ctx) {
+  Symtable *symtable = ctx->GetSymtable();
+  symtable->Push();
+  for (VarDecl *formal : *formals)
+    formal->Resolve(ctx);
+  if (body) body->Resolve(ctx);
+  symtable->Pop();
+}
+
+llvm::Function *FnDecl::GetFunction(IRGenerator *irgen) {
   llvm::Type *type = irgen->GetType(this->returnType);
   std::vector<llvm::Type *> argTypes;
-  for (int i = 0; i < formals->NumElements(); i++) {
-    Type *ty = formals->Nth(i)->GetType();
-    llvm::Type *varTy = irgen->GetType(ty);
+  for (VarDecl *formal : *formals) {
+    llvm::Type *varTy = irgen->GetType(formal->GetType());
     argTypes.push_back(varTy);
   }
-  llvm::ArrayRef<llvm::Type*> argArray(argTypes);
   llvm::FunctionType *funTy = llvm::FunctionType::get(type,argTypes,false);
-  llvm::Function *f = llvm::cast<llvm::Function>(
+  return llvm::cast<llvm::Function>(
     irgen->GetOrCreateModule("")->getOrInsertFunction(
-    llvm::StringRef(this->id->GetName()),funTy));
+    this->id->GetAtom().str(),funTy));
+}
+
+llvm::Value* FnDecl::Emit(CompilationContext *ctx) {
+  IRGenerator *irgen = ctx->GetIRGenerator();
+  PhaseTimer timer(ctx->GetTimeReport(), "emit", this->id->GetName());
+  llvm::Function *f = GetFunction(irgen);
   irgen->SetFunction(f);
   llvm::Function::arg_iterator args = f->arg_begin();
-  for (int i = 0; i < formals->NumElements(); i++) {
-   args->setName(formals->Nth(i)->GetIdentifier()->GetName());
+  for (VarDecl *formal : *formals) {
+   args->setName(formal->GetIdentifier()->GetAtom().str());
    ++args;
   }
   llvm::LLVMContext *context = irgen->GetContext();
   llvm::BasicBlock *bb = llvm::BasicBlock::Create(*context,"entry",f);
   irgen->SetBasicBlock(bb);
-  symtable->Push();
 
+  llvm::IRBuilder<> &builder = irgen->GetBuilder();
   llvm::Function::arg_iterator locArgs = f->arg_begin();
-  for (int i = 0; i < formals->NumElements(); i++) {
-    llvm::Type *locTy = irgen->GetType(formals->Nth(i)->GetType());
-    llvm::Twine *lName = new llvm::Twine(formals->Nth(i)->GetIdentifier()->GetName());
-    llvm::AllocaInst *allo = new llvm::AllocaInst(locTy,*lName,irgen->GetBasicBlock());
-    symtable->Insert(formals->Nth(i)->GetIdentifier()->GetName(), allo);
-    new llvm::StoreInst(locArgs, allo, irgen->GetBasicBlock());
-    ++args;
+  irgen->SealBlock(bb);
+  for (VarDecl *formal : *formals) {
+    if (formal->PlaceInSSA(irgen)) {
+      irgen->WriteVariable(formal, &*locArgs);
+    } else {
+      llvm::Type *locTy = irgen->GetType(formal->GetType());
+      const char *lName = formal->GetIdentifier()->GetName();
+      llvm::AllocaInst *allo = builder.CreateAlloca(locTy, NULL, lName);
+      formal->SetStorage(allo);
+      builder.CreateStore(&*locArgs, allo);
+    }
+    ++locArgs;
   }
   if (body) {
     llvm::BasicBlock *bodyblock = llvm::BasicBlock::Create(*context,"body",f);
-    llvm::BranchInst::Create(bodyblock,bb);
+    builder.CreateBr(bodyblock);
     irgen->SetBasicBlock(bodyblock);
-    body->Emit();
+    irgen->SealBlock(bodyblock);
+    body->Emit(ctx);
   }
-  symtable->Pop();
   if (irgen->GetBasicBlock()->getTerminator() == NULL)
   {
-     new llvm::UnreachableInst(*(irgen->GetContext()),irgen->GetBasicBlock());
+     builder.CreateUnreachable();
   }
   return NULL;
 }
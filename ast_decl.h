@@ -23,8 +23,6 @@ class NamedType;
 class Identifier;
 class Stmt;
 
-void yyerror(const char *msg);
-
 class Decl : public Node 
 {
   protected:
@@ -35,7 +33,7 @@ class Decl : public Node
     Decl(Identifier *name);
     Identifier *GetIdentifier() const { return id; }
     friend ostream& operator<<(ostream& out, Decl *d) { return out << d->id; }
-    virtual llvm::Value* Emit() { return NULL; }
+    virtual llvm::Value* Emit(CompilationContext *ctx) { return NULL; }
 };
 
 class VarDecl : public Decl 
@@ -44,22 +42,34 @@ class VarDecl : public Decl
     Type *type;
     TypeQualifier *typeq;
     Expr *assignTo;
+    bool isGlobal;          // declared at file scope, set by Resolve
+    llvm::Value *storage;   // the global or alloca, set by Emit
+    bool inSSA;             // kept in SSA values by the IRGenerator instead
+                            // of in storage, set by Emit
     
   public:
-    VarDecl() : type(NULL), typeq(NULL), assignTo(NULL) {}
+    VarDecl() : type(NULL), typeq(NULL), assignTo(NULL), isGlobal(false), storage(NULL),
+                inSSA(false) {}
     VarDecl(Identifier *name, Type *type, Expr *assignTo = NULL);
     VarDecl(Identifier *name, TypeQualifier *typeq, Expr *assignTo = NULL);
     VarDecl(Identifier *name, Type *type, TypeQualifier *typeq, Expr *assignTo = NULL);
     const char *GetPrintNameForNode() { return "VarDecl"; }
     void PrintChildren(int indentLevel);
     Type *GetType() const { return type; }
-    virtual llvm::Value* Emit();
+    llvm::Value *GetStorage() const { return storage; }
+    void SetStorage(llvm::Value *s) { storage = s; }
+    bool InSSA() const { return inSSA; }
+    // Decides whether the variable is built as SSA values: locals and
+    // formals that aren't arrays, when irgen builds SSA
+    bool PlaceInSSA(IRGenerator *irgen);
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class VarDeclError : public VarDecl
 {
   public:
-    VarDeclError() : VarDecl() { yyerror(this->GetPrintNameForNode()); };
+    VarDeclError();
     const char *GetPrintNameForNode() { return "VarDeclError"; }
 };
 
@@ -81,13 +91,17 @@ class FnDecl : public Decl
 
     Type *GetType() const { return returnType; }
     List<VarDecl*> *GetFormals() {return formals;}
-    virtual llvm::Value* Emit();
+    // the function in the module, declared on first use (by a call
+    // emitted before the definition) and defined by Emit
+    llvm::Function *GetFunction(IRGenerator *irgen);
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class FormalsError : public FnDecl
 {
   public:
-    FormalsError() : FnDecl() { yyerror(this->GetPrintNameForNode()); }
+    FormalsError();
     const char *GetPrintNameForNode() { return "FormalsError"; }
 };
 
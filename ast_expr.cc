@@ -4,86 +4,125 @@
  */
 
 #include <string.h>
+#include <memory>
 #include "ast_expr.h"
 #include "ast_type.h"
 #include "ast_decl.h"
 #include "symtable.h"
+#include "context.h"
+#include "errors.h"
 const int T = 1;
 const int ZERO = 0;
 
+// the error productions of the parser report what they stand for
+ExprError::ExprError() : Expr() {
+    ReportError::Formatted(NULL, "%s", GetPrintNameForNode());
+}
+
 IntConstant::IntConstant(yyltype loc, int val) : Expr(loc) {
     value = val;
+    type = Type::intType;
 }
 void IntConstant::PrintChildren(int indentLevel) { 
     printf("%d", value);
 }
-llvm::Value* IntConstant::Emit() {
+llvm::Value* IntConstant::Emit(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
     return llvm::ConstantInt::get(irgen->GetIntType(), value);
 }
 FloatConstant::FloatConstant(yyltype loc, double val) : Expr(loc) {
     value = val;
+    type = Type::floatType;
 }
 void FloatConstant::PrintChildren(int indentLevel) { 
     printf("%g", value);
 }
-llvm::Value* FloatConstant::Emit() {
+llvm::Value* FloatConstant::Emit(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
     return llvm::ConstantFP::get(irgen->GetFloatType(), value);
 }
 BoolConstant::BoolConstant(yyltype loc, bool val) : Expr(loc) {
     value = val;
+    type = Type::boolType;
 }
 void BoolConstant::PrintChildren(int indentLevel) { 
     printf("%s", value ? "true" : "false");
 }
-llvm::Value* BoolConstant::Emit() {
+llvm::Value* BoolConstant::Emit(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
     return llvm::ConstantInt::get(irgen->GetBoolType(), value);
 }
 VarExpr::VarExpr(yyltype loc, Identifier *ident) : Expr(loc) {
     Assert(ident != NULL);
     this->id = ident;
+    decl = NULL;
 }
 
 void VarExpr::PrintChildren(int indentLevel) {
     id->Print(indentLevel+1);
 }
 
-llvm::Value* VarExpr::Emit() {
-  llvm::Value *var = NULL;
-  for (int i = symtable->GetCurrentIndex(); i >= 0; i--) {
-    var = symtable->Lookup(i, id->GetName());
-    if (var != NULL) {
-      llvm::Twine* name = new llvm::Twine(id->GetName());
-      llvm::Value* out = new llvm::LoadInst(var,*name,irgen->GetBasicBlock());
-      return out;
-    }
-  }
+void VarExpr::Resolve(CompilationContext *ctx) {
+  decl = ctx->GetSymtable()->Lookup(id->GetAtom());
+  if (decl == NULL)
+    ReportError::IdentifierNotDeclared(id, LookingForVariable);
+  else if (decl->GetType() != NULL)
+    type = decl->GetType();
+}
+
+llvm::Value* VarExpr::Emit(CompilationContext *ctx) {
+  IRGenerator *irgen = ctx->GetIRGenerator();
+  if (decl != NULL && decl->InSSA())
+    return irgen->ReadVariable(decl, irgen->GetType(type));
+  llvm::Value *var = decl ? decl->GetStorage() : NULL;
+  if (var != NULL)
+    return irgen->GetBuilder().CreateLoad(var, id->GetName());
   return NULL;
 }
-llvm::Value* VarExpr::Store() {
-  llvm::Value *var = NULL;
-  for (int i = symtable->GetCurrentIndex(); i >= 0; i--) {
-    var = symtable->Lookup(i, id->GetName());
-    if (var != NULL) return var;
-  }
-  return var;
+void VarExpr::Assign(CompilationContext *ctx, llvm::Value *value) {
+  IRGenerator *irgen = ctx->GetIRGenerator();
+  if (decl == NULL)
+    return;
+  if (decl->InSSA())
+    irgen->WriteVariable(decl, value);
+  else
+    irgen->GetBuilder().CreateStore(value, decl->GetStorage());
 }
-Operator::Operator(yyltype loc, const char *tok) : Node(loc) {
-    Assert(tok != NULL);
-    strncpy(tokenString, tok, sizeof(tokenString));
+
+// a variable has no address to compute, so it is read and written afresh
+class VarRef : public LValueRef
+{
+    VarExpr *var;
+  public:
+    VarRef(VarExpr *var) : var(var) {}
+    llvm::Value *Load(CompilationContext *ctx) { return var->Emit(ctx); }
+    void Store(CompilationContext *ctx, llvm::Value *value) { var->Assign(ctx, value); }
+};
+
+LValueRef *VarExpr::EmitLValue(CompilationContext *ctx) {
+  return new VarRef(this);
+}
+const char *OpSpelling(OpKind kind) {
+    static const char *spelling[NumOpKinds] = {
+      "+", "-", "*", "/", "++", "--", "<", "<=", ">", ">=", "==", "!=",
+      "&&", "||", "=", "+=", "-=", "*=", "/="
+    };
+    return spelling[kind];
 }
 
-void Operator::PrintChildren(int indentLevel) {
-    printf("%s",tokenString);
+Operator::Operator(yyltype loc, OpKind k) : Node(loc) {
+    kind = k;
 }
 
-bool Operator::IsOp(const char *op) const {
-    return strcmp(tokenString, op) == 0;
+void Operator::PrintChildren(int indentLevel) {
+    printf("%s", OpSpelling(kind));
 }
 
 CompoundExpr::CompoundExpr(Expr *l, Operator *o, Expr *r) 
   : Expr(Join(l->GetLocation(), r->GetLocation())) {
     Assert(l != NULL && o != NULL && r != NULL);
     (op=o)->SetParent(this);
+    opKind = o->GetKind();
     (left=l)->SetParent(this); 
     (right=r)->SetParent(this);
 }
@@ -93,6 +132,7 @@ CompoundExpr::CompoundExpr(Operator *o, Expr *r)
     Assert(o != NULL && r != NULL);
     left = NULL; 
     (op=o)->SetParent(this);
+    opKind = o->GetKind();
     (right=r)->SetParent(this);
 }
 
@@ -101,6 +141,27 @@ CompoundExpr::CompoundExpr(Expr *l, Operator *o)
     Assert(l != NULL && o != NULL);
     (left=l)->SetParent(this);
     (op=o)->SetParent(this);
+    opKind = o->GetKind();
+}
+
+/* An operand that didn't check has already been reported, so the
+ * expression is given the error type without checking the operator.
+ */
+void CompoundExpr::Resolve(CompilationContext *ctx) {
+   if (left) left->Resolve(ctx);
+   if (right) right->Resolve(ctx);
+   if ((left && left->GetType()->IsError()) || (right && right->GetType()->IsError()))
+     type = Type::errorType;
+   else
+     type = CheckType();
+}
+
+int CompoundExpr::SpeculationCost() {
+   int l = left ? left->SpeculationCost() : 0;
+   int r = right ? right->SpeculationCost() : 0;
+   if (l < 0 || r < 0)
+     return -1;
+   return l + r + 1;
 }
 
 void CompoundExpr::PrintChildren(int indentLevel) {
@@ -108,283 +169,409 @@ void CompoundExpr::PrintChildren(int indentLevel) {
    op->Print(indentLevel+1);
    if (right) right->Print(indentLevel+1);
 }
-llvm::Value *RelationalExpr::Emit() {
-   llvm::Value* l = left->Emit();
-   llvm::Value* r = right->Emit();
-   llvm::Type* type = l->getType();
-   llvm::CmpInst::OtherOps ops;
-   llvm::Type* comp = irgen->GetIntType();
-   llvm::CmpInst::Predicate pred;
-
-   if (type == comp) ops = llvm::CmpInst::ICmp;
-   else ops = llvm::CmpInst::FCmp;
-
-   // LESS THAN
-   if ((string(op->getName())) == "<") {
-     if (type == comp) pred = llvm::ICmpInst::ICMP_SLT;
-     else pred = llvm::CmpInst::FCMP_OLT;
-     return llvm::CmpInst::Create(ops,pred,l,r,"",irgen->GetBasicBlock()); 
-   }
-   // LESS THAN OR EQUAL TO
-   else if ((string(op->getName())) == "<=") {
-     if (type == comp) pred = llvm::ICmpInst::ICMP_SLE;
-     else pred = llvm::CmpInst::FCMP_OLE;
-     return llvm::CmpInst::Create(ops,pred,l,r,"",irgen->GetBasicBlock());
-   }
-   // GREATER THAN
-   else if ((string(op->getName())) == ">") {
-     if (type == comp) pred = llvm::ICmpInst::ICMP_SGT;
-     else pred = llvm::CmpInst::FCMP_OGT;
-     return llvm::CmpInst::Create(ops,pred,l,r,"",irgen->GetBasicBlock());
-   }
-   // GREATER THAN OR EQUAL TO
-   else if ((string(op->getName())) == ">=") {
-     if (type == comp) pred = llvm::ICmpInst::ICMP_SGE;
-     else pred = llvm::CmpInst::FCMP_OGE;
-     return llvm::CmpInst::Create(ops,pred,l,r,"",irgen->GetBasicBlock());
-   }
+
+/* Whether values of type t are floating point or vectors or matrices of
+ * floating point, which selects the float or the integer instructions,
+ * and whether they are unsigned integers, which selects the unsigned
+ * division and comparisons.
+ */
+static bool IsFloating(Type *t) {
+   return t->GetComponentType()->IsEquivalentTo(Type::floatType);
+}
+
+static bool IsUnsigned(Type *t) {
+   return t->GetComponentType()->IsEquivalentTo(Type::uintType);
+}
+
+// scalars, vectors and matrices of int, uint or float
+static bool IsArithmetic(Type *t) {
+   return t->GetComponentType()->IsNumeric();
+}
+
+/* Type of an arithmetic operation on operands of types l and r, NULL if
+ * they don't combine. Besides operands of the same type, a scalar combines
+ * with a vector or a matrix of its type, giving the vector or matrix
+ * (x + v2 is a vec2).
+ */
+static Type *ArithmeticType(Type *l, Type *r) {
+   if (l->IsEquivalentTo(r) && IsArithmetic(l))
+     return l;
+   if (l->IsNumeric() && r != r->GetComponentType() && l->IsEquivalentTo(r->GetComponentType()))
+     return r;
+   if (r->IsNumeric() && l != l->GetComponentType() && r->IsEquivalentTo(l->GetComponentType()))
+     return l;
    return NULL;
 }
-llvm::Value* EqualityExpr::Emit() {
-  llvm::Value *l = left->Emit();
-  llvm::Value *r = right->Emit();
-  llvm::Type *type = l->getType();
-  llvm::CmpInst::OtherOps ops;
-  llvm::CmpInst::Predicate pred;
-  llvm::Type* comp = irgen->GetIntType();
-   
-  if (type == comp) ops = llvm::CmpInst::ICmp;
-  else ops = llvm::CmpInst::FCmp;
- 
-  // INEQUALITY
-  if ((string(op->getName())) == "!=") {
-    if (type == comp) pred = llvm::ICmpInst::ICMP_NE;
-    else pred = llvm::CmpInst::FCMP_ONE;
-    return llvm::CmpInst::Create(ops, pred, l, r, "", irgen->GetBasicBlock());
-  }
-  // EQUALITY
-  else if ((string(op->getName())) == "==") {
-    if (type == comp) pred = llvm::ICmpInst::ICMP_EQ;
-    else pred = llvm::CmpInst::FCMP_OEQ;
-    return llvm::CmpInst::Create(ops, pred, l, r, "", irgen->GetBasicBlock());
-  }  
-  return NULL;
+
+/* Reports an operand of an assignment, an increment or a decrement that
+ * cannot be assigned to (a + b = c, v.xx = w, f()++).
+ */
+static bool CheckAssignable(OpKind op, Expr *operand) {
+   if (operand->IsAssignable())
+     return true;
+   ReportError::Formatted(operand->GetLocation(),
+                          "Operand of '%s' cannot be assigned to", OpSpelling(op));
+   return false;
 }
-llvm::Value* LogicalExpr::Emit() {
-   llvm::Value *l = left->Emit();
-   llvm::Value *r = right->Emit();
-   if ((string(op->getName())) == "&&") {
-     return llvm::BinaryOperator::CreateAnd(l, r, "", irgen->GetBasicBlock());
-   }
-   else if ((string(op->getName())) == "||") {
-     return llvm::BinaryOperator::CreateOr(l, r, "", irgen->GetBasicBlock());
-   }
-   return NULL; 
-}
-llvm::Value* AssignExpr::Emit() {
-   llvm::Value *l;
-   llvm::Value *r = right->Emit();
-   // EQUAL ASSIGNMENT
-   if ((string(op->getName())) == "=") {
-     VarExpr* leftV = dynamic_cast<VarExpr*>(left);
-     llvm::Value* temp = leftV->Store();
-     return new llvm::StoreInst(r, temp, irgen->GetBasicBlock());
-   }
-   // MULTIPLICITIVE ASSIGNMENT
-   if ((string(op->getName())) == "*=") {
-     VarExpr* leftV = dynamic_cast<VarExpr*>(left);
-     llvm::Value* temp = leftV->Store();
-     l = left->Emit();
-     llvm::Value *res;
-     if (r->getType() == (llvm::Type*)irgen->GetIntType())
-       res  = llvm::BinaryOperator::CreateMul(l,r,"",irgen->GetBasicBlock());
-     else
-       res = llvm::BinaryOperator::CreateFMul(l,r,"",irgen->GetBasicBlock());
-     return new llvm::StoreInst(res, temp, irgen->GetBasicBlock());
-   }
-   // DIVISION ASSIGNMENT
-   if ((string(op->getName())) == "/=") {
-     VarExpr* leftV = dynamic_cast<VarExpr*>(left);
-     llvm::Value* temp = leftV->Store();
-     l = left->Emit();
-     llvm::Value *res;
-     if (r->getType() == (llvm::Type*)irgen->GetIntType())
-       res = llvm::BinaryOperator::CreateUDiv(l,r,"",irgen->GetBasicBlock());
-     else 
-       res = llvm::BinaryOperator::CreateFDiv(l,r,"",irgen->GetBasicBlock());
-     return new llvm::StoreInst(res, temp, irgen->GetBasicBlock());
-   }
-   // ADDITION ASSIGNMENT
-   if ((string(op->getName())) == "+=") {
-     VarExpr* leftV = dynamic_cast<VarExpr*>(left);
-     llvm::Value* temp = leftV->Store();
-     l = left->Emit();
-     llvm::Value *res;
-     if (r->getType() == (llvm::Type*)irgen->GetIntType())
-       res = llvm::BinaryOperator::CreateAdd(l,r,"",irgen->GetBasicBlock());
-     else 
-       res = llvm::BinaryOperator::CreateFAdd(l,r,"",irgen->GetBasicBlock());
-     return new llvm::StoreInst(res, temp, irgen->GetBasicBlock());
+
+Type *ArithmeticExpr::CheckType() {
+   Type *r = right->GetType();
+   if (left == NULL) {
+     if ((opKind == OpInc || opKind == OpDec) && !CheckAssignable(opKind, right))
+       return Type::errorType;
+     if (IsArithmetic(r))
+       return r;
+     ReportError::IncompatibleOperand(op, r);
+     return Type::errorType;
    }
-   // SUBTRACTION ASSIGNMENT
-   if ((string(op->getName())) == "-=") {
-     VarExpr* leftV = dynamic_cast<VarExpr*>(left);
-     llvm::Value* temp = leftV->Store();
-     l = left->Emit();
-     llvm::Value *res;
-     if (r->getType() == (llvm::Type*)irgen->GetIntType())
-       res = llvm::BinaryOperator::CreateSub(l,r,"",irgen->GetBasicBlock());
-     else 
-       res = llvm::BinaryOperator::CreateFSub(l,r,"",irgen->GetBasicBlock());
-     return new llvm::StoreInst(res, temp, irgen->GetBasicBlock());
+   Type *l = left->GetType();
+   Type *t = ArithmeticType(l, r);
+   if (t == NULL) {
+     ReportError::IncompatibleOperands(op, l, r);
+     return Type::errorType;
    }
-   return NULL; 
+   return t;
 }
-llvm::Value* ArithmeticExpr::Emit() {
-   llvm::Value *r = right->Emit();
-   llvm::Type *t = r->getType();
-   llvm::Value *l = NULL;
-   if (left != NULL) {
-     l = left->Emit();
-   }
-   llvm::Value *out = NULL;
-   // ADDITION
-   if ((string(op->getName())) == "+") {
-     if (t == (llvm::Type*)irgen->GetIntType())
-       out = llvm::BinaryOperator::CreateAdd(l,r,"",irgen->GetBasicBlock());
-     else
-       out = llvm::BinaryOperator::CreateFAdd(l,r,"",irgen->GetBasicBlock());
-   }
-   // SUBTRACTION
-   if ((string(op->getName())) == "-") {
-     if (t == (llvm::Type*)irgen->GetIntType())
-       out = llvm::BinaryOperator::CreateSub(l,r,"",irgen->GetBasicBlock());
-     else
-       out = llvm::BinaryOperator::CreateFSub(l,r,"",irgen->GetBasicBlock());
-   }
-   // MULTIPLICATION
-   if ((string(op->getName())) == "*") {
-     if (t == (llvm::Type*)irgen->GetIntType())
-       out = llvm::BinaryOperator::CreateMul(l,r,"",irgen->GetBasicBlock());
-     else
-       out = llvm::BinaryOperator::CreateFMul(l,r,"",irgen->GetBasicBlock());
+
+Type *RelationalExpr::CheckType() {
+   Type *l = left->GetType(), *r = right->GetType();
+   if (l->IsEquivalentTo(r) && l->IsNumeric())
+     return Type::boolType;
+   ReportError::IncompatibleOperands(op, l, r);
+   return Type::errorType;
+}
+
+Type *EqualityExpr::CheckType() {
+   Type *l = left->GetType(), *r = right->GetType();
+   if (l->IsEquivalentTo(r) && !l->IsEquivalentTo(Type::voidType))
+     return Type::boolType;
+   ReportError::IncompatibleOperands(op, l, r);
+   return Type::errorType;
+}
+
+Type *LogicalExpr::CheckType() {
+   Type *l = left->GetType(), *r = right->GetType();
+   if (l->IsEquivalentTo(Type::boolType) && r->IsEquivalentTo(Type::boolType))
+     return Type::boolType;
+   ReportError::IncompatibleOperands(op, l, r);
+   return Type::errorType;
+}
+
+/* A compound assignment checks like its arithmetic operator, and the
+ * result has to fit back into the left hand side (v2 += x is fine,
+ * x += v2 is not).
+ */
+Type *AssignExpr::CheckType() {
+   if (!CheckAssignable(opKind, left))
+     return Type::errorType;
+   Type *l = left->GetType(), *r = right->GetType();
+   Type *t = (opKind == OpAssign) ? r : ArithmeticType(l, r);
+   if (t != NULL && l->IsEquivalentTo(t))
+     return l;
+   ReportError::IncompatibleOperands(op, l, r);
+   return Type::errorType;
+}
+
+Type *PostfixExpr::CheckType() {
+   if (!CheckAssignable(opKind, left))
+     return Type::errorType;
+   Type *l = left->GetType();
+   if (IsArithmetic(l))
+     return l;
+   ReportError::IncompatibleOperand(op, l);
+   return Type::errorType;
+}
+
+/* Opcode of an arithmetic operator, of the arithmetic part of a compound
+ * assignment or of an increment/decrement, on integer or floating point
+ * operands.
+ */
+static llvm::Instruction::BinaryOps BinaryOpcode(OpKind op, Type *operandType) {
+   bool isFloat = IsFloating(operandType);
+   switch (op) {
+     case OpAdd: case OpAddAssign: case OpInc:
+       return isFloat ? llvm::Instruction::FAdd : llvm::Instruction::Add;
+     case OpSub: case OpSubAssign: case OpDec:
+       return isFloat ? llvm::Instruction::FSub : llvm::Instruction::Sub;
+     case OpMul: case OpMulAssign:
+       return isFloat ? llvm::Instruction::FMul : llvm::Instruction::Mul;
+     case OpDiv: case OpDivAssign:
+       if (isFloat) return llvm::Instruction::FDiv;
+       return IsUnsigned(operandType) ? llvm::Instruction::UDiv : llvm::Instruction::SDiv;
+     case OpAnd:
+       return llvm::Instruction::And;
+     case OpOr:
+       return llvm::Instruction::Or;
+     default:
+       Assert(0 && "not an arithmetic operator");
+       return llvm::Instruction::Add;
    }
-   // DIVISION
-   if ((string(op->getName())) == "/") {
-     if (t == (llvm::Type*)irgen->GetIntType())
-       out = llvm::BinaryOperator::CreateSDiv(l,r,"",irgen->GetBasicBlock());
-     else
-       out = llvm::BinaryOperator::CreateFDiv(l,r,"",irgen->GetBasicBlock());
+}
+
+/* Predicate of a comparison operator on operands of the given type:
+ * ordered for floats, unsigned for uint and signed for int (and bool).
+ */
+static llvm::CmpInst::Predicate ComparePredicate(OpKind op, Type *operandType) {
+   bool isFloat = IsFloating(operandType), isUnsigned = IsUnsigned(operandType);
+   switch (op) {
+     case OpLess:
+       return isFloat ? llvm::CmpInst::FCMP_OLT : isUnsigned ? llvm::CmpInst::ICMP_ULT : llvm::CmpInst::ICMP_SLT;
+     case OpLessEqual:
+       return isFloat ? llvm::CmpInst::FCMP_OLE : isUnsigned ? llvm::CmpInst::ICMP_ULE : llvm::CmpInst::ICMP_SLE;
+     case OpGreater:
+       return isFloat ? llvm::CmpInst::FCMP_OGT : isUnsigned ? llvm::CmpInst::ICMP_UGT : llvm::CmpInst::ICMP_SGT;
+     case OpGreaterEqual:
+       return isFloat ? llvm::CmpInst::FCMP_OGE : isUnsigned ? llvm::CmpInst::ICMP_UGE : llvm::CmpInst::ICMP_SGE;
+     case OpEqual:        return isFloat ? llvm::CmpInst::FCMP_OEQ : llvm::CmpInst::ICMP_EQ;
+     case OpNotEqual:     return isFloat ? llvm::CmpInst::FCMP_ONE : llvm::CmpInst::ICMP_NE;
+     default:
+       Assert(0 && "not a comparison operator");
+       return llvm::CmpInst::ICMP_EQ;
    }
-   // PRE INCREMENT
-   if ((string(op->getName())) == "++") {
-     if (t == (llvm::Type*)irgen->GetIntType()) {
-       llvm::Value *add = llvm::ConstantInt::get(irgen->GetIntType(),1);
-       out = llvm::BinaryOperator::CreateAdd(r,add,"",irgen->GetBasicBlock());
-     }
-     else { 
-       llvm::Value *add = llvm::ConstantFP::get(irgen->GetFloatType(),1.0);
-       out = llvm::BinaryOperator::CreateFAdd(r,add,"",irgen->GetBasicBlock());
+}
+
+/* Vectors are LLVM vectors, so an operator applies to all of their
+ * components with one instruction. A scalar operand of an operation on
+ * vectors is splatted to their width first; matrices are arrays of column
+ * vectors and are handled a column at a time.
+ */
+static llvm::Value *Splat(llvm::IRBuilder<> &builder, llvm::Value *v, llvm::Type *vecTy) {
+   llvm::VectorType *vt = llvm::dyn_cast<llvm::VectorType>(vecTy);
+   if (vt != NULL && v->getType() == vt->getElementType())
+     return builder.CreateVectorSplat(vt->getNumElements(), v);
+   return v;
+}
+
+// column i of a matrix operand, a splatted scalar is the same for all columns
+static llvm::Value *Column(llvm::IRBuilder<> &builder, llvm::Value *v, int i) {
+   if (v->getType()->isArrayTy())
+     return builder.CreateExtractValue(v, i);
+   return v;
+}
+
+/* The linear algebra product of two matrices of type ty: column j of the
+ * result is the sum of the columns of l, each scaled by the matching
+ * component of column j of r.
+ */
+static llvm::Value *EmitMatrixProduct(llvm::IRBuilder<> &builder, llvm::Type *ty,
+                                      llvm::Value *l, llvm::Value *r) {
+   int n = ty->getArrayNumElements();
+   llvm::Type *colTy = ty->getArrayElementType();
+   llvm::Value *result = llvm::UndefValue::get(ty);
+   for (int j = 0; j < n; j++) {
+     llvm::Value *rc = builder.CreateExtractValue(r, j);
+     llvm::Value *sum = NULL;
+     for (int k = 0; k < n; k++) {
+       llvm::Value *s = Splat(builder, builder.CreateExtractElement(rc, builder.getInt32(k)), colTy);
+       llvm::Value *term = builder.CreateFMul(builder.CreateExtractValue(l, k), s);
+       sum = sum ? builder.CreateFAdd(sum, term) : term;
      }
-     VarExpr* expr = dynamic_cast<VarExpr*>(right);
-     new llvm::StoreInst(out, expr->Store(), irgen->GetBasicBlock());
-     return out;
+     result = builder.CreateInsertValue(result, sum, j);
    }
-   // POST INCREMENT
-   if ((string(op->getName())) == "--") {
-     if (t == (llvm::Type*)irgen->GetIntType()) {
-       llvm::Value *sub = llvm::ConstantInt::get(irgen->GetIntType(),1);
-       out = llvm::BinaryOperator::CreateSub(r,sub,"",irgen->GetBasicBlock());
-     }
-     else {
-       llvm::Value *sub = llvm::ConstantFP::get(irgen->GetFloatType(),1.0);
-       out = llvm::BinaryOperator::CreateSub(r,sub,"",irgen->GetBasicBlock());
-     }
-     VarExpr* expr = dynamic_cast<VarExpr*>(right);
-     new llvm::StoreInst(out, expr->Store(), irgen->GetBasicBlock());
-     return out;
+   return result;
+}
+
+/* Applies the arithmetic operator op to l and r, giving a value of the
+ * given type. One of the operands has that type, the other one may be a
+ * scalar of its component type (see ArithmeticType).
+ */
+static llvm::Value *EmitArithmetic(IRGenerator *irgen, OpKind op, Type *type,
+                                   llvm::Value *l, llvm::Value *r) {
+   llvm::IRBuilder<> &builder = irgen->GetBuilder();
+   llvm::Type *ty = irgen->GetType(type);
+   llvm::Instruction::BinaryOps opcode = BinaryOpcode(op, type);
+   if (!type->IsMatrix())
+     return builder.CreateBinOp(opcode, Splat(builder, l, ty), Splat(builder, r, ty));
+   if (opcode == llvm::Instruction::FMul && l->getType() == ty && r->getType() == ty)
+     return EmitMatrixProduct(builder, ty, l, r);
+   llvm::Type *colTy = ty->getArrayElementType();
+   l = Splat(builder, l, colTy);
+   r = Splat(builder, r, colTy);
+   llvm::Value *result = llvm::UndefValue::get(ty);
+   for (unsigned i = 0; i < ty->getArrayNumElements(); i++) {
+     llvm::Value *col = builder.CreateBinOp(opcode, Column(builder, l, i), Column(builder, r, i));
+     result = builder.CreateInsertValue(result, col, i);
    }
-   return out;
-}
-llvm::Value* PostfixExpr::Emit() {
-   /*
-   llvm::Value *l = left->Emit();
-   llvm::Type *type = l->getType();
-   llvm::Value *out = NULL;
-   // POST INCREMENT
-   if ((string(op->getName())) == "++") { 
-     if (type == (llvm::Type*)irgen->GetIntType()) {
-       llvm::Value *add = llvm::ConstantInt::get(irgen->GetIntType(),1);
-       out = llvm::BinaryOperator::CreateAdd(l,add,"",irgen->GetBasicBlock());
-     }
-     else {
-       llvm::Value *add = llvm::ConstantFP::get(irgen->GetFloatType(),1.0);
-       out = llvm::BinaryOperator::CreateFAdd(l,add,"",irgen->GetBasicBlock());
+   return result;
+}
+
+/* Compares l and r. Vectors and matrices are compared a component at a
+ * time: == holds if it holds for all components and != if it holds for
+ * any, which for a vector is read off the bits of the <N x i1> result.
+ */
+static llvm::Value *EmitCompare(IRGenerator *irgen, OpKind op, Type *operandType,
+                               llvm::Value *l, llvm::Value *r) {
+   llvm::IRBuilder<> &builder = irgen->GetBuilder();
+   int n = operandType->NumComponents();
+   if (operandType->IsMatrix()) {
+     Type *colType = Type::VectorOf(operandType->GetComponentType(), n);
+     llvm::Value *result = NULL;
+     for (int i = 0; i < n; i++) {
+       llvm::Value *c = EmitCompare(irgen, op, colType, builder.CreateExtractValue(l, i),
+                                    builder.CreateExtractValue(r, i));
+       if (result == NULL)
+         result = c;
+       else
+         result = (op == OpEqual) ? builder.CreateAnd(result, c) : builder.CreateOr(result, c);
      }
-     VarExpr* expr = dynamic_cast<VarExpr*>(left);
-     new llvm::StoreInst(out, expr->Store(), irgen->GetBasicBlock());
-     return out;
+     return result;
    }
-   // PRE DECREMENT
-   if ((string(op->getName())) == "--") {
-     if (type == (llvm::Type*)irgen->GetIntType()) {
-       llvm::Value *sub = llvm::ConstantInt::get(irgen->GetIntType(),1);
-       out = llvm::BinaryOperator::CreateSub(l,sub,"",irgen->GetBasicBlock());
-     }
-     else {
-       llvm::Value *sub = llvm::ConstantFP::get(irgen->GetFloatType(),1.0);
-       out = llvm::BinaryOperator::CreateSub(l,sub,"",irgen->GetBasicBlock());
-     }
-     VarExpr* expr = dynamic_cast<VarExpr*>(left);
-     new llvm::StoreInst(out, expr->Store(), irgen->GetBasicBlock());
-     return out;
-   } */
-    llvm::Type* leftType = left->Emit()->getType();
-    Operator *op = this->op;
-
-    llvm::LoadInst *inst = llvm::cast<llvm::LoadInst>(left->Emit());
-    llvm::Value *loc = inst->getPointerOperand();
+   llvm::CmpInst::Predicate pred = ComparePredicate(op, operandType);
+   llvm::Value *cmp = IsFloating(operandType) ? builder.CreateFCmp(pred, l, r)
+                                              : builder.CreateICmp(pred, l, r);
+   if (!operandType->IsVector())
+     return cmp;
+   llvm::Type *bitsTy = builder.getIntNTy(n);
+   llvm::Value *bits = builder.CreateBitCast(cmp, bitsTy);
+   if (op == OpEqual)
+     return builder.CreateICmpEQ(bits, llvm::Constant::getAllOnesValue(bitsTy));
+   return builder.CreateICmpNE(bits, llvm::Constant::getNullValue(bitsTy));
+}
 
-    llvm::BasicBlock *bb = irgen->GetBasicBlock();
-    llvm::Type *intType = irgen->GetIntType();
-    llvm::Value *val1 = llvm::ConstantInt::get(intType, 1);
+llvm::Value *RelationalExpr::Emit(CompilationContext *ctx) {
+   IRGenerator *irgen = ctx->GetIRGenerator();
+   llvm::Value* l = left->Emit(ctx);
+   llvm::Value* r = right->Emit(ctx);
+   return EmitCompare(irgen, opKind, left->GetType(), l, r);
+}
+llvm::Value* EqualityExpr::Emit(CompilationContext *ctx) {
+  IRGenerator *irgen = ctx->GetIRGenerator();
+  llvm::Value *l = left->Emit(ctx);
+  llvm::Value *r = right->Emit(ctx);
+  return EmitCompare(irgen, opKind, left->GetType(), l, r);
+}
+/* Right operands up to this cost are evaluated unconditionally and
+ * combined with a bitwise and/or, which is cheaper than the branches.
+ */
+static const int MaxSpeculationCost = 4;
 
-    if (leftType->isIntegerTy()) {
-        if (op->IsOp("++") == true) {
-            llvm::Value *increment = llvm::BinaryOperator::CreateAdd(left->Emit(), val1, "intInc", bb);
-            llvm::Value *storeInst = new llvm::StoreInst(increment, loc, bb);
-            (void)storeInst;
+/* The right operand of && is only evaluated when the left one is true,
+ * and that of || when it is false. A constant left operand decides it
+ * while emitting; otherwise the right operand gets a block of its own
+ * and a phi merges the result, unless the right operand can safely and
+ * cheaply be evaluated anyway (see Expr::SpeculationCost).
+ */
+llvm::Value* LogicalExpr::Emit(CompilationContext *ctx) {
+   IRGenerator *irgen = ctx->GetIRGenerator();
+   llvm::IRBuilder<> &builder = irgen->GetBuilder();
+   bool isAnd = (opKind == OpAnd);
+   llvm::Value *l = left->Emit(ctx);
+   if (llvm::ConstantInt *c = llvm::dyn_cast<llvm::ConstantInt>(l)) {
+     if (c->isZero() == isAnd)
+       return l;                    // false && ..., true || ...
+     return right->Emit(ctx);
+   }
 
-            return inst;
-        }
+   int cost = right->SpeculationCost();
+   if (cost >= 0 && cost <= MaxSpeculationCost) {
+     llvm::Value *r = right->Emit(ctx);
+     return builder.CreateBinOp(BinaryOpcode(opKind, type), l, r);
+   }
 
-        else if (op->IsOp("--") == true) {
-            llvm::Value *decrement = llvm::BinaryOperator::CreateSub(left->Emit(), val1, "intDec", bb);
-            llvm::Value *storeInst = new llvm::StoreInst(decrement, loc, bb);
-            (void)storeInst;
+   llvm::LLVMContext *c = irgen->GetContext();
+   llvm::Function *f = irgen->GetFunction();
+   llvm::BasicBlock *leftB = irgen->GetBasicBlock();
+   llvm::BasicBlock *rightB = llvm::BasicBlock::Create(*c, isAnd ? "and.rhs" : "or.rhs", f);
+   llvm::BasicBlock *endB = llvm::BasicBlock::Create(*c, isAnd ? "and.end" : "or.end", f);
+   if (isAnd)
+     builder.CreateCondBr(l, rightB, endB);
+   else
+     builder.CreateCondBr(l, endB, rightB);
 
-            return inst;
-        }
-    }
+   irgen->SetBasicBlock(rightB);
+   irgen->SealBlock(rightB);
+   llvm::Value *r = right->Emit(ctx);
+   rightB = irgen->GetBasicBlock();    // the right operand may have split it
+   builder.CreateBr(endB);
 
-    else if (leftType->isFloatTy()) {
-        if (op->IsOp("++")== true) {
-            llvm::Value *increment = llvm::BinaryOperator::CreateAdd(left->Emit(), val1, "floatInc", bb);
-            llvm::Value *storeInst = new llvm::StoreInst(increment, loc, bb);
-           (void)storeInst;
+   irgen->SetBasicBlock(endB);
+   irgen->SealBlock(endB);
+   llvm::PHINode *phi = builder.CreatePHI(irgen->GetBoolType(), 2);
+   phi->addIncoming(llvm::ConstantInt::get(irgen->GetBoolType(), !isAnd), leftB);
+   phi->addIncoming(r, rightB);
+   return phi;
+}
+int ArithmeticExpr::SpeculationCost() {
+   if (opKind == OpInc || opKind == OpDec || opKind == OpDiv)
+     return -1;
+   return CompoundExpr::SpeculationCost();
+}
+// unary plus and minus of a constant, as in case -1:
+bool ArithmeticExpr::FoldInt(int *value) {
+   if (left != NULL || (opKind != OpAdd && opKind != OpSub) || !right->FoldInt(value))
+     return false;
+   if (opKind == OpSub)
+     *value = -*value;
+   return true;
+}
 
-            return inst;
-        }
+// the value of an assignment is the value stored, so a = b = c works
+llvm::Value* AssignExpr::Emit(CompilationContext *ctx) {
+   IRGenerator *irgen = ctx->GetIRGenerator();
+   llvm::Value *r = right->Emit(ctx);
+   std::unique_ptr<LValueRef> ref(left->EmitLValue(ctx));
+   if (opKind != OpAssign) {
+     // +=, -=, *=, /=: apply the operator to the old value first
+     r = EmitArithmetic(irgen, opKind, type, ref->Load(ctx), r);
+   }
+   ref->Store(ctx, r);
+   return r;
+}
+llvm::Value* ArithmeticExpr::Emit(CompilationContext *ctx) {
+   IRGenerator *irgen = ctx->GetIRGenerator();
+   llvm::IRBuilder<> &builder = irgen->GetBuilder();
+   bool isFloat = IsFloating(type);
+   if (left == NULL && (opKind == OpInc || opKind == OpDec)) {
+     // PRE INCREMENT AND DECREMENT
+     std::unique_ptr<LValueRef> ref(right->EmitLValue(ctx));
+     llvm::Type *t = irgen->GetType(type->GetComponentType());
+     llvm::Value *one = isFloat ? llvm::ConstantFP::get(t, 1.0)
+                                : llvm::ConstantInt::get(t, 1);
+     llvm::Value *out = EmitArithmetic(irgen, opKind, type, ref->Load(ctx), one);
+     ref->Store(ctx, out);
+     return out;
+   }
+   llvm::Value *r = right->Emit(ctx);
+   if (left != NULL) {
+     llvm::Value *l = left->Emit(ctx);
+     switch (opKind) {
+       case OpAdd: case OpSub: case OpMul: case OpDiv:
+         return EmitArithmetic(irgen, opKind, type, l, r);
+       default:
+         return NULL;
+     }
+   }
+   switch (opKind) {
+     // UNARY PLUS AND MINUS
+     case OpAdd:
+       return r;
+     case OpSub:
+       if (type->IsMatrix())          // -1 * m negates exactly, zeros included
+         return EmitArithmetic(irgen, OpMul, type, r,
+                               llvm::ConstantFP::get(irgen->GetFloatType(), -1.0));
+       if (isFloat)
+         return builder.CreateFNeg(r);
+       return builder.CreateNeg(r);
+     default:
+       return NULL;
+   }
+}
+/* The value of a postfix increment or decrement is the one loaded before
+ * the variable is updated.
+ */
+llvm::Value* PostfixExpr::Emit(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
 
-        else if (op->IsOp("--")==true) {
-            llvm::Value *decrement = llvm::BinaryOperator::CreateSub(left->Emit(), val1, "floatDec", bb);
-          llvm::Value *storeInst = new llvm::StoreInst(decrement, loc, bb);
-              (void)storeInst;
+    std::unique_ptr<LValueRef> ref(left->EmitLValue(ctx));
+    llvm::Value *old = ref->Load(ctx);
+    llvm::Type *t = irgen->GetType(type->GetComponentType());
+    bool isFloat = IsFloating(type);
 
-            return inst;
-        }
-    }
-    return NULL;
+    llvm::Value *one = isFloat ? llvm::ConstantFP::get(t, 1.0)
+                               : llvm::ConstantInt::get(t, 1);
+    llvm::Value *update = EmitArithmetic(irgen, opKind, type, old, one);
+    ref->Store(ctx, update);
+    return old;
 }   
 ConditionalExpr::ConditionalExpr(Expr *c, Expr *t, Expr *f)
   : Expr(Join(c->GetLocation(), f->GetLocation())) {
@@ -399,6 +586,76 @@ void ConditionalExpr::PrintChildren(int indentLevel) {
     trueExpr->Print(indentLevel+1, "(true) ");
     falseExpr->Print(indentLevel+1, "(false) ");
 }
+
+void ConditionalExpr::Resolve(CompilationContext *ctx) {
+    cond->Resolve(ctx);
+    trueExpr->Resolve(ctx);
+    falseExpr->Resolve(ctx);
+    Type *c = cond->GetType();
+    if (!c->IsError() && !c->IsEquivalentTo(Type::boolType))
+      ReportError::TestNotBoolean(cond);
+    Type *t = trueExpr->GetType(), *f = falseExpr->GetType();
+    if (t->IsEquivalentTo(f))
+      type = t;
+    else if (!t->IsError() && !f->IsError())
+      ReportError::Formatted(GetLocation(), "The two sides of '?:' have different types");
+}
+
+int ConditionalExpr::SpeculationCost() {
+    int c = cond->SpeculationCost();
+    int t = trueExpr->SpeculationCost(), f = falseExpr->SpeculationCost();
+    if (c < 0 || t < 0 || f < 0)
+      return -1;
+    return c + t + f + 1;
+}
+
+/* Only the side selected by the condition is evaluated. A constant
+ * condition picks it while emitting, and sides that can both safely and
+ * cheaply be evaluated (see Expr::SpeculationCost) become a select;
+ * otherwise each side gets a block and a phi merges their values.
+ */
+llvm::Value* ConditionalExpr::Emit(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
+    llvm::IRBuilder<> &builder = irgen->GetBuilder();
+    llvm::Value *c = cond->Emit(ctx);
+    if (llvm::ConstantInt *k = llvm::dyn_cast<llvm::ConstantInt>(c))
+      return k->isZero() ? falseExpr->Emit(ctx) : trueExpr->Emit(ctx);
+
+    int t = trueExpr->SpeculationCost(), f = falseExpr->SpeculationCost();
+    if (t >= 0 && f >= 0 && t + f <= MaxSpeculationCost) {
+      llvm::Value *tv = trueExpr->Emit(ctx);
+      llvm::Value *fv = falseExpr->Emit(ctx);
+      return builder.CreateSelect(c, tv, fv);
+    }
+
+    llvm::LLVMContext *context = irgen->GetContext();
+    llvm::Function *fn = irgen->GetFunction();
+    llvm::BasicBlock *trueB = llvm::BasicBlock::Create(*context, "cond.true", fn);
+    llvm::BasicBlock *falseB = llvm::BasicBlock::Create(*context, "cond.false", fn);
+    llvm::BasicBlock *endB = llvm::BasicBlock::Create(*context, "cond.end", fn);
+    builder.CreateCondBr(c, trueB, falseB);
+
+    irgen->SetBasicBlock(trueB);
+    irgen->SealBlock(trueB);
+    llvm::Value *tv = trueExpr->Emit(ctx);
+    trueB = irgen->GetBasicBlock();     // the side may have split it
+    builder.CreateBr(endB);
+
+    irgen->SetBasicBlock(falseB);
+    irgen->SealBlock(falseB);
+    llvm::Value *fv = falseExpr->Emit(ctx);
+    falseB = irgen->GetBasicBlock();
+    builder.CreateBr(endB);
+
+    irgen->SetBasicBlock(endB);
+    irgen->SealBlock(endB);
+    if (tv == NULL || tv->getType()->isVoidTy())
+      return NULL;                      // calls of void functions
+    llvm::PHINode *phi = builder.CreatePHI(tv->getType(), 2);
+    phi->addIncoming(tv, trueB);
+    phi->addIncoming(fv, falseB);
+    return phi;
+}
 ArrayAccess::ArrayAccess(yyltype loc, Expr *b, Expr *s) : LValue(loc) {
     (base=b)->SetParent(this); 
     (subscript=s)->SetParent(this);
@@ -408,6 +665,93 @@ void ArrayAccess::PrintChildren(int indentLevel) {
     base->Print(indentLevel+1);
     subscript->Print(indentLevel+1, "(subscript) ");
 }
+
+/* Indexing an array gives an element and indexing a matrix one of its
+ * columns.
+ */
+void ArrayAccess::Resolve(CompilationContext *ctx) {
+    base->Resolve(ctx);
+    subscript->Resolve(ctx);
+    Type *t = base->GetType();
+    if (ArrayType *at = dynamic_cast<ArrayType*>(t))
+      type = at->GetElemType();
+    else if (t->IsMatrix())
+      type = Type::VectorOf(Type::floatType, t->NumComponents());
+    else if (!t->IsError()) {
+      VarExpr *var = dynamic_cast<VarExpr*>(base);
+      if (var) ReportError::NotAnArray(var->GetIdentifier());
+      else ReportError::Formatted(GetLocation(), "Subscripted value is not an array");
+    }
+    Type *s = subscript->GetType();
+    if (!s->IsError() && !s->IsEquivalentTo(Type::intType) && !s->IsEquivalentTo(Type::uintType)) {
+      ReportError::Formatted(subscript->GetLocation(), "Array subscript is not an integer");
+      type = Type::errorType;
+    }
+}
+
+/* An element whose address is computed once. A base that is a value
+ * rather than a variable in memory, such as a matrix built as SSA values,
+ * is copied to the stack first, and after a store the updated copy is
+ * stored back to the base through baseRef.
+ */
+class ElementRef : public LValueRef
+{
+    llvm::Value *ptr, *spill;
+    std::unique_ptr<LValueRef> baseRef;
+  public:
+    ElementRef(llvm::Value *ptr, llvm::Value *spill, LValueRef *baseRef)
+      : ptr(ptr), spill(spill), baseRef(baseRef) {}
+    llvm::Value *Load(CompilationContext *ctx) {
+      return ctx->GetIRGenerator()->GetBuilder().CreateLoad(ptr);
+    }
+    void Store(CompilationContext *ctx, llvm::Value *value) {
+      llvm::IRBuilder<> &builder = ctx->GetIRGenerator()->GetBuilder();
+      builder.CreateStore(value, ptr);
+      if (spill != NULL)
+        baseRef->Store(ctx, builder.CreateLoad(spill));
+    }
+};
+
+// the storage of a variable in memory (arrays always are), or NULL
+static llvm::Value *MemoryStorage(Expr *e) {
+    VarExpr *var = dynamic_cast<VarExpr*>(e);
+    if (var == NULL || var->GetDecl() == NULL || var->GetDecl()->InSSA())
+      return NULL;
+    return var->GetDecl()->GetStorage();
+}
+
+static llvm::Value *Spill(IRGenerator *irgen, llvm::Value *value) {
+    llvm::Value *ptr = irgen->CreateEntryAlloca(value->getType(), "subscripted");
+    irgen->GetBuilder().CreateStore(value, ptr);
+    return ptr;
+}
+
+static llvm::Value *ElementPtr(IRGenerator *irgen, llvm::Value *ptr, llvm::Value *subscript) {
+    llvm::IRBuilder<> &builder = irgen->GetBuilder();
+    llvm::Value *index[] = { builder.getInt32(0), subscript };
+    return builder.CreateInBoundsGEP(ptr, index);
+}
+
+llvm::Value* ArrayAccess::Emit(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
+    llvm::Value *ptr = MemoryStorage(base);
+    if (ptr == NULL)
+      ptr = Spill(irgen, base->Emit(ctx));
+    ptr = ElementPtr(irgen, ptr, subscript->Emit(ctx));
+    return irgen->GetBuilder().CreateLoad(ptr);
+}
+
+LValueRef *ArrayAccess::EmitLValue(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
+    llvm::Value *ptr = MemoryStorage(base), *spill = NULL;
+    LValueRef *baseRef = NULL;
+    if (ptr == NULL) {
+      baseRef = base->EmitLValue(ctx);
+      ptr = spill = Spill(irgen, baseRef->Load(ctx));
+    }
+    ptr = ElementPtr(irgen, ptr, subscript->Emit(ctx));
+    return new ElementRef(ptr, spill, baseRef);
+}
      
 FieldAccess::FieldAccess(Expr *b, Identifier *f) 
   : LValue(b? Join(b->GetLocation(), f->GetLocation()) : *f->GetLocation()) {
@@ -423,12 +767,126 @@ void FieldAccess::PrintChildren(int indentLevel) {
     field->Print(indentLevel+1);
 }
 
+// the names of the components of a vector in a swizzle, in order
+static const char SwizzleComponents[] = "xyzw";
+
+static int ComponentIndex(char c) {
+    return strchr(SwizzleComponents, c) - SwizzleComponents;
+}
+
+/* The field is a swizzle of base, not a name to look up: one to four of
+ * the components x, y, z and w of a vector, giving a float or a vector of
+ * as many components.
+ */
+void FieldAccess::Resolve(CompilationContext *ctx) {
+    if (base == NULL) return;
+    base->Resolve(ctx);
+    Type *t = base->GetType();
+    if (t->IsError()) return;
+    if (!t->IsVector()) {
+      ReportError::InaccessibleSwizzle(field, base);
+      return;
+    }
+    const char *swizzle = field->GetName();
+    int len = strlen(swizzle);
+    for (int i = 0; i < len; i++) {
+      if (strchr(SwizzleComponents, swizzle[i]) == NULL) {
+        ReportError::InvalidSwizzle(field, base);
+        return;
+      }
+      if (ComponentIndex(swizzle[i]) >= t->NumComponents()) {
+        ReportError::SwizzleOutOfBound(field, base);
+        return;
+      }
+    }
+    if (len > 4) {
+      ReportError::OversizedVector(field, base);
+      return;
+    }
+    type = Type::VectorOf(t->GetComponentType(), len);
+}
+
+int FieldAccess::SpeculationCost() {
+   int cost = base ? base->SpeculationCost() : -1;
+   return cost < 0 ? -1 : cost + 1;
+}
+
+/* A swizzle of one component is an extractelement from the base vector,
+ * a longer one a shufflevector of it (v.zyx, v.xxxx).
+ */
+static llvm::Value *EmitSwizzle(IRGenerator *irgen, llvm::Value *v, const char *swizzle) {
+    llvm::IRBuilder<> &builder = irgen->GetBuilder();
+    int len = strlen(swizzle);
+    if (len == 1)
+      return builder.CreateExtractElement(v, builder.getInt32(ComponentIndex(swizzle[0])));
+    llvm::SmallVector<llvm::Constant*, 4> mask;
+    for (int i = 0; i < len; i++)
+      mask.push_back(builder.getInt32(ComponentIndex(swizzle[i])));
+    return builder.CreateShuffleVector(v, llvm::UndefValue::get(v->getType()),
+                                       llvm::ConstantVector::get(mask));
+}
+
+llvm::Value* FieldAccess::Emit(CompilationContext *ctx) {
+    if (base == NULL) return NULL;
+    return EmitSwizzle(ctx->GetIRGenerator(), base->Emit(ctx), field->GetName());
+}
+
+// a swizzle naming a component twice (v.xx) cannot be assigned to
+bool FieldAccess::IsAssignable() {
+    if (base == NULL || !base->IsAssignable())
+      return false;
+    const char *swizzle = field->GetName();
+    for (int i = 0; swizzle[i] != '\0'; i++) {
+      if (strchr(swizzle + i + 1, swizzle[i]) != NULL)
+        return false;
+    }
+    return true;
+}
+
+/* A swizzle of an assignable vector. A store replaces the components
+ * named in the value of the base with insertelement and stores the result
+ * back to the base.
+ */
+class SwizzleRef : public LValueRef
+{
+    std::unique_ptr<LValueRef> baseRef;
+    const char *swizzle;
+  public:
+    SwizzleRef(LValueRef *baseRef, const char *swizzle)
+      : baseRef(baseRef), swizzle(swizzle) {}
+    llvm::Value *Load(CompilationContext *ctx) {
+      return EmitSwizzle(ctx->GetIRGenerator(), baseRef->Load(ctx), swizzle);
+    }
+    void Store(CompilationContext *ctx, llvm::Value *value) {
+      llvm::IRBuilder<> &builder = ctx->GetIRGenerator()->GetBuilder();
+      llvm::Value *v = baseRef->Load(ctx);
+      int len = strlen(swizzle);
+      for (int i = 0; i < len; i++) {
+        llvm::Value *c = value;
+        if (len > 1)
+          c = builder.CreateExtractElement(value, builder.getInt32(i));
+        v = builder.CreateInsertElement(v, c, builder.getInt32(ComponentIndex(swizzle[i])));
+      }
+      baseRef->Store(ctx, v);
+    }
+};
+
+LValueRef *FieldAccess::EmitLValue(CompilationContext *ctx) {
+    return new SwizzleRef(base->EmitLValue(ctx), field->GetName());
+}
+
 Call::Call(yyltype loc, Expr *b, Identifier *f, List<Expr*> *a) : Expr(loc)  {
     Assert(f != NULL && a != NULL); // b can be be NULL (just means no explicit base)
     base = b;
     if (base) base->SetParent(this);
     (field=f)->SetParent(this);
     (actuals=a)->SetParentAll(this);
+    actuals->ShrinkToFit();
+    callee = NULL;
+}
+
+ActualsError::ActualsError() : Call() {
+    ReportError::Formatted(NULL, "%s", GetPrintNameForNode());
 }
 
 void Call::PrintChildren(int indentLevel) {
@@ -437,3 +895,54 @@ void Call::PrintChildren(int indentLevel) {
    if (actuals) actuals->PrintAll(indentLevel+1, "(actuals) ");
 }
 
+/* A call is bound to the function it names, its actuals have to match
+ * the types of the formals, and it has the return type of the function.
+ */
+void Call::Resolve(CompilationContext *ctx) {
+   if (base) base->Resolve(ctx);
+   for (Expr *actual : *actuals) {
+     actual->Resolve(ctx);
+   }
+   Symtable *symtable = ctx->GetSymtable();
+   Atom name = field->GetAtom();
+   callee = symtable->LookupFunction(name);
+   if (callee == NULL) {
+     if (symtable->Lookup(name) != NULL)
+       ReportError::NotAFunction(field);
+     else
+       ReportError::IdentifierNotDeclared(field, LookingForFunction);
+     return;
+   }
+   List<VarDecl*> *formals = callee->GetFormals();
+   int expected = formals->NumElements(), given = actuals->NumElements();
+   if (given > expected) {
+     ReportError::ExtraFormals(field, expected, given);
+     return;
+   }
+   if (given < expected) {
+     ReportError::LessFormals(field, expected, given);
+     return;
+   }
+   bool ok = true;
+   for (int i = 0; i < given; i++) {
+     Type *formal = formals->Nth(i)->GetType(), *actual = actuals->Nth(i)->GetType();
+     if (actual->IsError()) {
+       ok = false;
+     } else if (!formal->IsEquivalentTo(actual)) {
+       ReportError::FormalsTypeMismatch(field, i+1, formal, actual);
+       ok = false;
+     }
+   }
+   if (ok)
+     type = callee->GetType();
+}
+
+// the function is declared in the module if its definition comes later
+llvm::Value* Call::Emit(CompilationContext *ctx) {
+   IRGenerator *irgen = ctx->GetIRGenerator();
+   std::vector<llvm::Value*> args;
+   for (Expr *actual : *actuals)
+     args.push_back(actual->Emit(ctx));
+   return irgen->GetBuilder().CreateCall(callee->GetFunction(irgen), args);
+}
+
@@ -18,24 +18,59 @@
 #include "list.h"
 #include "ast_type.h"
 
-void yyerror(const char *msg);
+class VarDecl;
+class FnDecl;
+
+/* Class: LValueRef
+ * ----------------
+ * An assignable location whose address (subscripts, swizzle base) has
+ * already been emitted, so a read-modify-write loads and stores through
+ * it without evaluating the operand's side effects twice.
+ */
+class LValueRef
+{
+  public:
+    virtual ~LValueRef() {}
+    virtual llvm::Value *Load(CompilationContext *ctx) = 0;
+    virtual void Store(CompilationContext *ctx, llvm::Value *value) = 0;
+};
 
 class Expr : public Stmt 
 {
+  protected:
+    Type *type;         // set by Resolve, errorType if it doesn't check
+
   public:
-    Expr(yyltype loc) : Stmt(loc) {}
-    Expr() : Stmt() {}
+    Expr(yyltype loc) : Stmt(loc), type(Type::errorType) {}
+    Expr() : Stmt(), type(Type::errorType) {}
+    Type *GetType() { return type; }
+
+    // The cost, roughly in instructions, of evaluating the expression
+    // even where it might not be (the right side of && and ||), or -1 if
+    // it must not be: it has side effects (assignments, increments,
+    // calls) or divides, which can trap and is slow anyway.
+    virtual int SpeculationCost() { return -1; }
+
+    // The value of an integer constant expression (a literal, possibly
+    // negated) in *value, false if the expression isn't one
+    virtual bool FoldInt(int *value) { return false; }
+
+    // Whether the expression can be assigned to (a variable, a subscript
+    // or a swizzle of one without repeated components), and the location
+    // it names, only called if it can; the caller owns the reference
+    virtual bool IsAssignable() { return false; }
+    virtual LValueRef *EmitLValue(CompilationContext *ctx) { return NULL; }
 
     friend std::ostream& operator<< (std::ostream& stream, Expr * expr) {
         return stream << expr->GetPrintNameForNode();
     }
-    virtual llvm::Value* Emit() { return NULL; }
+    virtual llvm::Value* Emit(CompilationContext *ctx) { return NULL; }
 };
 
 class ExprError : public Expr
 {
   public:
-    ExprError() : Expr() { yyerror(this->GetPrintNameForNode()); }
+    ExprError();
     const char *GetPrintNameForNode() { return "ExprError"; }
 };
 
@@ -45,6 +80,7 @@ class ExprError : public Expr
 class EmptyExpr : public Expr
 {
   public:
+    EmptyExpr() : Expr() { type = Type::voidType; }
     const char *GetPrintNameForNode() { return "Empty"; }
 };
 
@@ -57,7 +93,9 @@ class IntConstant : public Expr
     IntConstant(yyltype loc, int val);
     const char *GetPrintNameForNode() { return "IntConstant"; }
     void PrintChildren(int indentLevel);
-    virtual llvm::Value* Emit();
+    int SpeculationCost() { return 0; }
+    bool FoldInt(int *v) { *v = value; return true; }
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class FloatConstant: public Expr 
@@ -69,7 +107,8 @@ class FloatConstant: public Expr
     FloatConstant(yyltype loc, double val);
     const char *GetPrintNameForNode() { return "FloatConstant"; }
     void PrintChildren(int indentLevel);
-    virtual llvm::Value* Emit();
+    int SpeculationCost() { return 0; }
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class BoolConstant : public Expr 
@@ -81,42 +120,68 @@ class BoolConstant : public Expr
     BoolConstant(yyltype loc, bool val);
     const char *GetPrintNameForNode() { return "BoolConstant"; }
     void PrintChildren(int indentLevel);
+    int SpeculationCost() { return 0; }
     bool getValue() { return value; }
-    virtual llvm::Value* Emit();
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class VarExpr : public Expr
 {
   protected:
     Identifier *id;
+    VarDecl *decl;      // the declaration id refers to, set by Resolve
 
   public:
     VarExpr(yyltype loc, Identifier *id);
     const char *GetPrintNameForNode() { return "VarExpr"; }
     void PrintChildren(int indentLevel);
     Identifier *GetIdentifier() {return id;}
-    virtual llvm::Value* Emit();
-    llvm::Value* Store();
+    VarDecl *GetDecl() {return decl;}
+    int SpeculationCost() { return 1; }
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
+    bool IsAssignable() { return true; }
+    LValueRef *EmitLValue(CompilationContext *ctx);
+    // stores value in the variable, or makes it its current SSA value
+    void Assign(CompilationContext *ctx, llvm::Value *value);
 };
 
+/* Enum: OpKind
+ * ------------
+ * The operators of the language. The scanner hands the kind of each
+ * operator token to the parser, and the expression nodes keep it so Emit
+ * can switch on it.
+ */
+typedef enum {
+      OpAdd, OpSub, OpMul, OpDiv,                 // + - * / (+ - also unary)
+      OpInc, OpDec,                               // ++ --
+      OpLess, OpLessEqual, OpGreater, OpGreaterEqual,
+      OpEqual, OpNotEqual,                        // == !=
+      OpAnd, OpOr,                                // && ||
+      OpAssign, OpAddAssign, OpSubAssign, OpMulAssign, OpDivAssign,
+      NumOpKinds
+} OpKind;
+
+const char *OpSpelling(OpKind kind);   // e.g. "+=" for OpAddAssign
+
 class Operator : public Node 
 {
   protected:
-    char tokenString[4];
+    OpKind kind;
     
   public:
-    Operator(yyltype loc, const char *tok);
+    Operator(yyltype loc, OpKind kind);
     const char *GetPrintNameForNode() { return "Operator"; }
     void PrintChildren(int indentLevel);
-    friend ostream& operator<<(ostream& out, Operator *o) { return out << o->tokenString; }
-    bool IsOp(const char *op) const;
-    char *getName() { return tokenString; }
+    friend ostream& operator<<(ostream& out, Operator *o) { return out << OpSpelling(o->kind); }
+    OpKind GetKind() const { return kind; }
  };
  
 class CompoundExpr : public Expr
 {
   protected:
     Operator *op;
+    OpKind opKind;      // the kind of op, kept here for Emit
     Expr *left, *right; // left will be NULL if unary
     
   public:
@@ -124,7 +189,12 @@ class CompoundExpr : public Expr
     CompoundExpr(Operator *op, Expr *rhs);             // for unary
     CompoundExpr(Expr *lhs, Operator *op);             // for unary
     void PrintChildren(int indentLevel);
-    virtual llvm::Value* Emit() { return NULL; } 
+    void Resolve(CompilationContext *ctx);
+    // the type of the expression given the types of its operands, called
+    // by Resolve once they are resolved; reports operands that don't fit
+    virtual Type *CheckType() { return Type::errorType; }
+    int SpeculationCost();
+    virtual llvm::Value* Emit(CompilationContext *ctx) { return NULL; } 
 };
 
 class ArithmeticExpr : public CompoundExpr 
@@ -133,7 +203,10 @@ class ArithmeticExpr : public CompoundExpr
     ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
     const char *GetPrintNameForNode() { return "ArithmeticExpr"; }
-    virtual llvm::Value* Emit();
+    Type *CheckType();
+    int SpeculationCost();
+    bool FoldInt(int *value);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class RelationalExpr : public CompoundExpr 
@@ -141,7 +214,8 @@ class RelationalExpr : public CompoundExpr
   public:
     RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "RelationalExpr"; }
-    virtual llvm::Value *Emit();
+    Type *CheckType();
+    virtual llvm::Value *Emit(CompilationContext *ctx);
 };
 
 class EqualityExpr : public CompoundExpr 
@@ -149,7 +223,8 @@ class EqualityExpr : public CompoundExpr
   public:
     EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "EqualityExpr"; }
-    virtual llvm::Value *Emit();
+    Type *CheckType();
+    virtual llvm::Value *Emit(CompilationContext *ctx);
 };
 
 class LogicalExpr : public CompoundExpr 
@@ -158,7 +233,8 @@ class LogicalExpr : public CompoundExpr
     LogicalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
     const char *GetPrintNameForNode() { return "LogicalExpr"; }
-    virtual llvm::Value *Emit();
+    Type *CheckType();
+    virtual llvm::Value *Emit(CompilationContext *ctx);
 };
 
 class AssignExpr : public CompoundExpr 
@@ -166,7 +242,9 @@ class AssignExpr : public CompoundExpr
   public:
     AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "AssignExpr"; }
-    virtual llvm::Value* Emit(); 
+    Type *CheckType();
+    int SpeculationCost() { return -1; }
+    virtual llvm::Value* Emit(CompilationContext *ctx); 
 };
 
 class PostfixExpr : public CompoundExpr
@@ -174,7 +252,9 @@ class PostfixExpr : public CompoundExpr
   public:
     PostfixExpr(Expr *lhs, Operator *op) : CompoundExpr(lhs,op) {}
     const char *GetPrintNameForNode() { return "PostfixExpr"; }
-    virtual llvm::Value* Emit();
+    Type *CheckType();
+    int SpeculationCost() { return -1; }
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class ConditionalExpr : public Expr
@@ -184,7 +264,10 @@ class ConditionalExpr : public Expr
   public:
     ConditionalExpr(Expr *c, Expr *t, Expr *f);
     void PrintChildren(int indentLevel);
+    void Resolve(CompilationContext *ctx);
     const char *GetPrintNameForNode() { return "ConditionalExpr"; }
+    int SpeculationCost();
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class LValue : public Expr 
@@ -202,6 +285,10 @@ class ArrayAccess : public LValue
     ArrayAccess(yyltype loc, Expr *base, Expr *subscript);
     const char *GetPrintNameForNode() { return "ArrayAccess"; }
     void PrintChildren(int indentLevel);
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
+    bool IsAssignable() { return base->IsAssignable(); }
+    LValueRef *EmitLValue(CompilationContext *ctx);
 };
 
 /* Note that field access is used both for qualified names
@@ -219,6 +306,11 @@ class FieldAccess : public LValue
     FieldAccess(Expr *base, Identifier *field); //ok to pass NULL base
     const char *GetPrintNameForNode() { return "FieldAccess"; }
     void PrintChildren(int indentLevel);
+    int SpeculationCost();
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
+    bool IsAssignable();
+    LValueRef *EmitLValue(CompilationContext *ctx);
 };
 
 /* Like field access, call is used both for qualified base.field()
@@ -231,18 +323,21 @@ class Call : public Expr
     Expr *base;	// will be NULL if no explicit base
     Identifier *field;
     List<Expr*> *actuals;
+    FnDecl *callee;     // the function called, set by Resolve
     
   public:
-    Call() : Expr(), base(NULL), field(NULL), actuals(NULL) {}
+    Call() : Expr(), base(NULL), field(NULL), actuals(NULL), callee(NULL) {}
     Call(yyltype loc, Expr *base, Identifier *field, List<Expr*> *args);
     const char *GetPrintNameForNode() { return "Call"; }
     void PrintChildren(int indentLevel);
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class ActualsError : public Call
 {
   public:
-    ActualsError() : Call() { yyerror(this->GetPrintNameForNode()); }
+    ActualsError();
     const char *GetPrintNameForNode() { return "ActualsError"; }
 };
 
@@ -7,15 +7,51 @@
 #include "ast_decl.h"
 #include "ast_expr.h"
 #include "symtable.h"
+#include "context.h"
+#include "trace.h"
+#include "errors.h"
+#include <algorithm>
 
 #include "irgen.h"
-#include "llvm/Bitcode/ReaderWriter.h"
-#include "llvm/Support/raw_ostream.h"                                                   
+
+/* Line of the node for trace spans, 0 if the parser gave it no location.
+ */
+static int LineOf(Node *n) {
+    CompilationContext *ctx = CompilationContext::Current();
+    if (!IsTracing() || !n || !n->GetLocation() || !ctx) return 0;
+    return ctx->LineOf(n->GetLocation()->begin);
+}
 
 
 Program::Program(List<Decl*> *d) {
     Assert(d != NULL);
     (decls=d)->SetParentAll(this);
+    decls->ShrinkToFit();
+}
+
+/* Binds every variable use and every call in the program to its
+ * declaration, so Emit never looks a name up, and works out the type of
+ * every expression bottom up, so Emit knows which lowering to use without
+ * probing the values it built. Reports the names used without being
+ * declared and the operands that don't fit their operator. Scopes are
+ * opened for functions, blocks, for loops and the branches of an if.
+ * The functions are declared first, so a call may come before the
+ * function it calls.
+ */
+void Program::Resolve(CompilationContext *ctx) {
+    Symtable *symtable = ctx->GetSymtable();
+    for (Decl *decl : *decls) {
+      FnDecl *fn = dynamic_cast<FnDecl*>(decl);
+      if (fn == NULL) continue;
+      Atom name = fn->GetIdentifier()->GetAtom();
+      if (FnDecl *prev = symtable->LookupFunction(name))
+        ReportError::DeclConflict(fn, prev);
+      else
+        symtable->InsertFunction(name, fn);
+    }
+    for (Decl *decl : *decls) {
+      decl->Resolve(ctx);
+    }
 }
 
 void Program::PrintChildren(int indentLevel) {
@@ -23,7 +59,8 @@ void Program::PrintChildren(int indentLevel) {
     printf("\n");
 }
 
-llvm::Value* Program::Emit() {
+llvm::Value* Program::Emit(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
     // TODO:
     // This is just a reference for you to get started
     //
@@ -58,11 +95,11 @@ llvm::Value* Program::Emit() {
     // write the BC into standard output
     llvm::WriteBitcodeToFile(mod, llvm::outs());
     */
-    llvm::Module *mod = irgen->GetOrCreateModule("Program.bc");
-    for (int i =0; i < decls->NumElements(); i++) {
-      decls->Nth(i)->Emit();
+    // the module is written out (or run) by the driver in main.cc
+    irgen->GetOrCreateModule("Program.bc");
+    for (Decl *decl : *decls) {
+      decl->Emit(ctx);
     }
-    llvm::WriteBitcodeToFile(mod, llvm::outs());
     return NULL;
 }
 
@@ -70,6 +107,8 @@ StmtBlock::StmtBlock(List<VarDecl*> *d, List<Stmt*> *s) {
     Assert(d != NULL && s != NULL);
     (decls=d)->SetParentAll(this);
     (stmts=s)->SetParentAll(this);
+    decls->ShrinkToFit();
+    stmts->ShrinkToFit();
 }
 
 void StmtBlock::PrintChildren(int indentLevel) {
@@ -77,10 +116,28 @@ void StmtBlock::PrintChildren(int indentLevel) {
     stmts->PrintAll(indentLevel+1);
 }
 
-llvm::Value *StmtBlock::Emit() {
-    for (int i = 0; i < stmts->NumElements(); i++) {
-      stmts->Nth(i)->Emit();
+void StmtBlock::Resolve(CompilationContext *ctx) {
+    Symtable *symtable = ctx->GetSymtable();
+    symtable->Push();
+    for (VarDecl *decl : *decls) {
+      decl->Resolve(ctx);
+    }
+    for (Stmt *stmt : *stmts) {
+      stmt->Resolve(ctx);
+    }
+    symtable->Pop();
+}
+
+/* The locals declared in the block die at its end; a break, continue or
+ * return that leaves it earlier ends them on its own way out.
+ */
+llvm::Value *StmtBlock::Emit(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
+    size_t scope = irgen->LiveLocals();
+    for (Stmt *stmt : *stmts) {
+      stmt->Emit(ctx);
     }
+    irgen->CloseScope(scope);
     return NULL;
 } 
 
@@ -93,8 +150,12 @@ void DeclStmt::PrintChildren(int indentLevel) {
     decl->Print(indentLevel+1);
 }
 
-llvm::Value* DeclStmt::Emit() {
-    decl->Emit();
+void DeclStmt::Resolve(CompilationContext *ctx) {
+    decl->Resolve(ctx);
+}
+
+llvm::Value* DeclStmt::Emit(CompilationContext *ctx) {
+    decl->Emit(ctx);
     return NULL;
 } 
 
@@ -103,7 +164,12 @@ ConditionalStmt::ConditionalStmt(Expr *t, Stmt *b) {
     (test=t)->SetParent(this); 
     (body=b)->SetParent(this);
 }
-llvm::Value* LoopStmt::Emit() { return NULL; }
+void ConditionalStmt::Resolve(CompilationContext *ctx) {
+    test->Resolve(ctx);
+    body->Resolve(ctx);
+}
+
+llvm::Value* LoopStmt::Emit(CompilationContext *ctx) { return NULL; }
 ForStmt::ForStmt(Expr *i, Expr *t, Expr *s, Stmt *b): LoopStmt(t, b) { 
     Assert(i != NULL && t != NULL && b != NULL);
     (init=i)->SetParent(this);
@@ -120,7 +186,19 @@ void ForStmt::PrintChildren(int indentLevel) {
     body->Print(indentLevel+1, "(body) ");
 }
 
-llvm::Value* ForStmt::Emit(){
+void ForStmt::Resolve(CompilationContext *ctx) {
+    Symtable *symtable = ctx->GetSymtable();
+    symtable->Push();
+    init->Resolve(ctx);
+    test->Resolve(ctx);
+    if (step) step->Resolve(ctx);
+    body->Resolve(ctx);
+    symtable->Pop();
+}
+
+llvm::Value* ForStmt::Emit(CompilationContext *ctx){
+    IRGenerator *irgen = ctx->GetIRGenerator();
+    TraceSpan span("stmt", "for", LineOf(test));
 
     llvm::LLVMContext *c = irgen->GetContext();
     llvm::Function *f = irgen->GetFunction();
@@ -128,29 +206,29 @@ llvm::Value* ForStmt::Emit(){
     llvm::BasicBlock *stepB = llvm::BasicBlock::Create(*c, "step", f);
     llvm::BasicBlock *bodyB = llvm::BasicBlock::Create(*c, "body", f);
     llvm::BasicBlock *footB = llvm::BasicBlock::Create(*c, "foot", f);
-    std::cout << "ForStmt\n";
     //irgen->breakStck.push(footB);
     //irgen->contStck.push(stepB);
 
-    init->Emit();
+    init->Emit(ctx);
     
-    llvm::BranchInst::Create(headB, irgen->GetBasicBlock());
+    irgen->BranchTo(headB);
     irgen->SetBasicBlock(headB);
-    llvm::Value* value = test->Emit();
+    llvm::Value* value = test->Emit(ctx);
     
-    llvm::BranchInst::Create(bodyB, footB, value, headB);
+    irgen->GetBuilder().CreateCondBr(value, bodyB, footB);
     
-    //irgen->SetBasicBlock(bodyB);
-    symtable->Push();
     irgen->SetBasicBlock(bodyB);
-    irgen->breakStck.push(footB);
-    irgen->contStck.push(stepB);
-    body->Emit();
-    llvm::BranchInst::Create(stepB,irgen->GetBasicBlock());
-    symtable->Pop();
+    irgen->SealBlock(bodyB);
+    irgen->breakStck.push(IRGenerator::JumpTarget(footB, irgen->LiveLocals()));
+    irgen->contStck.push(IRGenerator::JumpTarget(stepB, irgen->LiveLocals()));
+    body->Emit(ctx);
+    irgen->BranchTo(stepB);
     irgen->SetBasicBlock(stepB);
-    step->Emit();
-    llvm::BranchInst::Create(headB, stepB);
+    irgen->SealBlock(stepB);
+    step->Emit(ctx);
+    irgen->BranchTo(headB);
+    irgen->SealBlock(headB);
+    irgen->SealBlock(footB);
     
     //irgen->breakStck.pop();
     //irgen->contStck.pop();
@@ -160,12 +238,14 @@ llvm::Value* ForStmt::Emit(){
     return NULL;
 }
 
-llvm::Value *ContinueStmt::Emit() {
-    llvm::BranchInst::Create(irgen->contStck.top(), irgen->GetBasicBlock());
+llvm::Value *ContinueStmt::Emit(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
+    irgen->JumpTo(irgen->contStck.top());
     return NULL;
 }
-llvm::Value *BreakStmt::Emit() {
-    llvm::BranchInst::Create(irgen->breakStck.top(), irgen->GetBasicBlock());
+llvm::Value *BreakStmt::Emit(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
+    irgen->JumpTo(irgen->breakStck.top());
     return NULL;
 }
 void WhileStmt::PrintChildren(int indentLevel) {
@@ -175,20 +255,29 @@ void WhileStmt::PrintChildren(int indentLevel) {
 
 
 
-llvm::Value* WhileStmt::Emit(){
+llvm::Value* WhileStmt::Emit(CompilationContext *ctx){
+    IRGenerator *irgen = ctx->GetIRGenerator();
+    TraceSpan span("stmt", "while", LineOf(test));
     llvm::LLVMContext *c = irgen->GetContext();
     llvm::Function *f = irgen->GetFunction();
     llvm::BasicBlock *headB = llvm::BasicBlock::Create(*c, "head", f);
     llvm::BasicBlock *bodyB = llvm::BasicBlock::Create(*c, "body", f);
     llvm::BasicBlock *footB = llvm::BasicBlock::Create(*c, "foot", f);
    
-    llvm::BranchInst::Create(headB, irgen->GetBasicBlock());
+    irgen->BranchTo(headB);
     irgen->SetBasicBlock(headB);
-    llvm::Value* testV = test->Emit();
-    llvm::BranchInst::Create(bodyB, footB, testV, headB);
-    irgen->SetBasicBlock(footB);
-    body->Emit();
-    llvm::BranchInst::Create(headB,footB);
+    llvm::Value* testV = test->Emit(ctx);
+    irgen->GetBuilder().CreateCondBr(testV, bodyB, footB);
+    irgen->SetBasicBlock(bodyB);
+    irgen->SealBlock(bodyB);
+    irgen->breakStck.push(IRGenerator::JumpTarget(footB, irgen->LiveLocals()));
+    irgen->contStck.push(IRGenerator::JumpTarget(headB, irgen->LiveLocals()));
+    body->Emit(ctx);
+    irgen->BranchTo(headB);
+    irgen->SealBlock(headB);
+    irgen->SealBlock(footB);
+    irgen->breakStck.pop();
+    irgen->contStck.pop();
     irgen->SetBasicBlock(footB);
     return NULL;
 }
@@ -200,35 +289,54 @@ IfStmt::IfStmt(Expr *t, Stmt *tb, Stmt *eb): ConditionalStmt(t, tb) {
     if (elseBody) elseBody->SetParent(this);
 }
 
+// the error productions of the parser report what they stand for
+IfStmtExprError::IfStmtExprError() : IfStmt() {
+    ReportError::Formatted(NULL, "%s", GetPrintNameForNode());
+}
+
 void IfStmt::PrintChildren(int indentLevel) {
     if (test) test->Print(indentLevel+1, "(test) ");
     if (body) body->Print(indentLevel+1, "(then) ");
     if (elseBody) elseBody->Print(indentLevel+1, "(else) ");
 }
 
-llvm::Value* IfStmt::Emit(){
+void IfStmt::Resolve(CompilationContext *ctx) {
+  Symtable *symtable = ctx->GetSymtable();
+  test->Resolve(ctx);
+  symtable->Push();
+  body->Resolve(ctx);
+  symtable->Pop();
+  if (elseBody != NULL) {
+    symtable->Push();
+    elseBody->Resolve(ctx);
+    symtable->Pop();
+  }
+}
+
+llvm::Value* IfStmt::Emit(CompilationContext *ctx){
+  IRGenerator *irgen = ctx->GetIRGenerator();
+  TraceSpan span("stmt", "if", LineOf(test));
   llvm::Function *function = irgen->GetFunction();
   llvm::LLVMContext *c = irgen->GetContext();
-  llvm::Value* valueB = test->Emit();
-  llvm::BasicBlock* footB = llvm::BasicBlock::Create(*c, "Foot", function);
+  llvm::Value* valueB = test->Emit(ctx);
+  llvm::BasicBlock* thenB = llvm::BasicBlock::Create(*c, "then", function);
   llvm::BasicBlock* elseB = NULL;
   if(elseBody != NULL)
     elseB = llvm::BasicBlock::Create(*c, "else", function);
-  llvm::BasicBlock* thenB = llvm::BasicBlock::Create(*c, "then", function);
-  llvm::BranchInst::Create(thenB,elseBody?elseB:footB,valueB, irgen->GetBasicBlock());
-  symtable->Push();
+  llvm::BasicBlock* footB = llvm::BasicBlock::Create(*c, "Foot", function);
+  irgen->GetBuilder().CreateCondBr(valueB, thenB, elseBody?elseB:footB);
   irgen->SetBasicBlock(thenB);
-  body->Emit();
-  symtable->Pop();
-  llvm::BranchInst::Create(footB, thenB);
+  irgen->SealBlock(thenB);
+  body->Emit(ctx);
+  irgen->BranchTo(footB);
   if (elseBody != NULL) { 
-    symtable->Push();
     irgen->SetBasicBlock(elseB);
-    elseBody->Emit();
-    llvm::BranchInst::Create(footB, elseB);
-    symtable->Pop();
-    irgen->SetBasicBlock(footB);
+    irgen->SealBlock(elseB);
+    elseBody->Emit(ctx);
+    irgen->BranchTo(footB);
   }
+  irgen->SetBasicBlock(footB);
+  irgen->SealBlock(footB);
   return NULL;
 }
 
@@ -242,13 +350,19 @@ void ReturnStmt::PrintChildren(int indentLevel) {
       expr->Print(indentLevel+1);
 }
 
-llvm::Value *ReturnStmt::Emit() {
-  llvm::LLVMContext *c = irgen->GetContext();
-  llvm::BasicBlock *bb = irgen->GetBasicBlock();
+void ReturnStmt::Resolve(CompilationContext *ctx) {
+  if (expr != NULL) expr->Resolve(ctx);
+}
+
+llvm::Value *ReturnStmt::Emit(CompilationContext *ctx) {
+  IRGenerator *irgen = ctx->GetIRGenerator();
+  // the value may be read from a local, so it is computed before they die
+  llvm::Value *value = expr ? expr->Emit(ctx) : NULL;
+  irgen->EndLifetimes(0);
   if (expr != NULL)
-    llvm::ReturnInst::Create(*c, expr->Emit(), bb);
+    irgen->GetBuilder().CreateRet(value);
   else 
-    llvm::ReturnInst::Create(*c, bb); 
+    irgen->GetBuilder().CreateRetVoid();
   return NULL;
 }
 SwitchLabel::SwitchLabel(Expr *l, Stmt *s) {
@@ -267,55 +381,136 @@ void SwitchLabel::PrintChildren(int indentLevel) {
     if (label) label->Print(indentLevel+1);
     if (stmt)  stmt->Print(indentLevel+1);
 }
-llvm::Value* SwitchLabel::Emit() { return NULL; }
-llvm::Value* Case::Emit() { return NULL; }
-llvm::Value* Default::Emit() { return NULL; }
+void SwitchLabel::Resolve(CompilationContext *ctx) {
+    if (label) label->Resolve(ctx);
+    if (stmt)  stmt->Resolve(ctx);
+}
+
+// the label itself is handled by SwitchStmt::Emit
+llvm::Value* SwitchLabel::Emit(CompilationContext *ctx) {
+    if (stmt) stmt->Emit(ctx);
+    return NULL;
+}
+
 SwitchStmt::SwitchStmt(Expr *e, List<Stmt *> *c, Default *d) {
     Assert(e != NULL && c != NULL && c->NumElements() != 0 );
     (expr=e)->SetParent(this);
     (cases=c)->SetParentAll(this);
+    cases->ShrinkToFit();
     def = d;
     if (def) def->SetParent(this);
 }
 
+SwitchStmtError::SwitchStmtError(const char *msg) {
+    ReportError::Formatted(NULL, "%s", msg);
+}
+
 void SwitchStmt::PrintChildren(int indentLevel) {
     if (expr) expr->Print(indentLevel+1);
     if (cases) cases->PrintAll(indentLevel+1);
     if (def) def->Print(indentLevel+1);
 }
 
-llvm::Value*  SwitchStmt::Emit() {
-    /*
-    int i = 0;
+static bool IsInteger(Type *t) {
+    return t->IsEquivalentTo(Type::intType) || t->IsEquivalentTo(Type::uintType);
+}
+
+typedef std::pair<int, Expr*> CaseLabel;
+
+static bool LabelLess(const CaseLabel &a, const CaseLabel &b) {
+    return a.first < b.first;
+}
+
+/* The switch expression must be an integer, and the case labels distinct
+ * integer constants.
+ */
+void SwitchStmt::Resolve(CompilationContext *ctx) {
+    expr->Resolve(ctx);
+    Type *t = expr->GetType();
+    if (!t->IsError() && !IsInteger(t))
+      ReportError::Formatted(expr->GetLocation(), "Switch expression is not an integer");
+    std::vector<CaseLabel> labels;
+    for (Stmt *stmt : *cases) {
+      stmt->Resolve(ctx);
+      SwitchLabel *label = dynamic_cast<SwitchLabel*>(stmt);
+      Expr *labelExpr = label ? label->returnLabel() : NULL;
+      if (labelExpr == NULL || labelExpr->GetType()->IsError())
+        continue;
+      int value;
+      if (!IsInteger(labelExpr->GetType()) || !labelExpr->FoldInt(&value))
+        ReportError::Formatted(labelExpr->GetLocation(), "Case label is not a constant integer");
+      else
+        labels.push_back(CaseLabel(value, labelExpr));
+    }
+    if (def) def->Resolve(ctx);
+
+    std::stable_sort(labels.begin(), labels.end(), LabelLess);
+    for (size_t i = 1; i < labels.size(); i++) {
+      if (labels[i].first == labels[i-1].first)
+        ReportError::Formatted(labels[i].second->GetLocation(), "Duplicate case label %d",
+                               labels[i].first);
+    }
+}
+
+/* Each case and the default get a block, entered from a SwitchInst, which
+ * the code generator lowers to a jump table or a binary search as the
+ * labels suit, and by falling through from the statements before it; a
+ * break leaves for the block after the switch.
+ */
+llvm::Value*  SwitchStmt::Emit(CompilationContext *ctx) {
+    IRGenerator *irgen = ctx->GetIRGenerator();
+    TraceSpan span("stmt", "switch", LineOf(expr));
+    llvm::IRBuilder<> &builder = irgen->GetBuilder();
     llvm::LLVMContext *c = irgen->GetContext();
     llvm::Function *f = irgen->GetFunction();
-    llvm::BasicBlock *defaultB = llvm::BasicBlock::Create(*c,"default");
-    llvm::BasicBlock *footB = llvm::BasicBlock::Create(*c, "foot");
-    breakStck->push(footB);
-    llvm::SwitchInst *switchI = llvm::SwitchInst::Create(expr->Emit(), defaultB, cases->NumElements(), irgen->GetBasicBlock());
-    irgen->GetBasicBlock();
-    while (i < cases->NumElements()) {
-      if (dynamic_cast<Case*>(cases->Nth(i))) {
-        llvm::BasicBlock *caseB = llvm::BasicBlock::Create(*c, "case", f);
-        llvm::Value* cond = dynamic_cast<Case*>(cases->Nth(i))->returnLabel()->Emit();
-        switchI->addCase((llvm::ConstantInt*)cond, caseB);
-        if (irgen->GetBasicBlock()->getTerminator() == NULL)
-          llvm::BranchInst::Create(caseB, irgen->GetBasicBlock());
-        irgen->SetBasicBlock(caseB);
-        ((SwitchLabel*)cases->Nth(i))->Emit();
-      } else if (dynamic_cast<Default*>(cases->Nth(i))) {
-        if (irgen->GetBasicBlock()->getTerminator() == NULL)
-          llvm::BranchInst::Create(defaultB, irgen->GetBasicBlock());
-        irgen->SetBasicBlock(defaultB);
-        ((SwitchLabel*)cases->Nth(i))->Emit();
+
+    llvm::Value *value = expr->Emit(ctx);
+    llvm::IntegerType *t = llvm::cast<llvm::IntegerType>(value->getType());
+    std::vector<std::pair<llvm::ConstantInt*, llvm::BasicBlock*> > targets;
+    std::vector<llvm::BasicBlock*> labelBlocks;
+    llvm::BasicBlock *defaultB = NULL;
+    for (Stmt *stmt : *cases) {
+      SwitchLabel *label = dynamic_cast<SwitchLabel*>(stmt);
+      if (label == NULL) {
+        labelBlocks.push_back(NULL);
+      } else if (label->returnLabel() == NULL) {
+        defaultB = llvm::BasicBlock::Create(*c, "default", f);
+        labelBlocks.push_back(defaultB);
       } else {
-        cases->Nth(i)->Emit();
+        llvm::BasicBlock *caseB = llvm::BasicBlock::Create(*c, "case", f);
+        labelBlocks.push_back(caseB);
+        int v = 0;
+        label->returnLabel()->FoldInt(&v);
+        targets.push_back(std::make_pair(llvm::ConstantInt::get(t, v, true), caseB));
       }
-      i++;
     }
-    if (irgen->GetBasicBlock()->getTerminator() == NULL)
-      llvm::BranchInst::Create(footB,defaultB);
-    breakStck->pop();
+    llvm::BasicBlock *footB = llvm::BasicBlock::Create(*c, "foot", f);
+    if (defaultB == NULL)
+      defaultB = footB;
+
+    llvm::SwitchInst *sw = builder.CreateSwitch(value, defaultB, targets.size());
+    for (size_t i = 0; i < targets.size(); i++)
+      sw->addCase(targets[i].first, targets[i].second);
+
+    size_t scope = irgen->LiveLocals();
+    irgen->breakStck.push(IRGenerator::JumpTarget(footB, scope));
+    for (int i = 0; i < cases->NumElements(); i++) {
+      if (llvm::BasicBlock *labelB = labelBlocks[i]) {
+        irgen->BranchTo(labelB);            // fall through
+        irgen->SetBasicBlock(labelB);
+        irgen->SealBlock(labelB);
+      } else if (irgen->GetBasicBlock()->getTerminator() != NULL) {
+        // statements after a break that no label leads to
+        llvm::BasicBlock *deadB = llvm::BasicBlock::Create(*c, "dead", f);
+        irgen->SetBasicBlock(deadB);
+        irgen->SealBlock(deadB);
+      }
+      cases->Nth(i)->Emit(ctx);
+    }
+    irgen->CloseScope(scope);           // locals declared among the cases
+    irgen->BranchTo(footB);
+    irgen->breakStck.pop();
     irgen->SetBasicBlock(footB);
-    */return NULL; 
+    irgen->SealBlock(footB);
+    return NULL;
 }
@@ -21,8 +21,6 @@ class VarDecl;
 class Expr;
 class IntConstant;
   
-void yyerror(const char *msg);
-
 class Program : public Node
 {
   protected:
@@ -32,7 +30,8 @@ class Program : public Node
      Program(List<Decl*> *declList);
      const char *GetPrintNameForNode() { return "Program"; }
      void PrintChildren(int indentLevel);
-     virtual llvm::Value* Emit();
+     void Resolve(CompilationContext *ctx);
+     virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class Stmt : public Node
@@ -52,7 +51,8 @@ class StmtBlock : public Stmt
     StmtBlock(List<VarDecl*> *variableDeclarations, List<Stmt*> *statements);
     const char *GetPrintNameForNode() { return "StmtBlock"; }
     void PrintChildren(int indentLevel);
-    virtual llvm::Value* Emit();
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class DeclStmt: public Stmt 
@@ -63,8 +63,10 @@ class DeclStmt: public Stmt
   public:
     DeclStmt(Decl *d);
     const char *GetPrintNameForNode() { return "DeclStmt"; }
+    Decl *GetDecl() { return decl; }
     void PrintChildren(int indentLevel);
-    virtual llvm::Value* Emit();
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
   
 class ConditionalStmt : public Stmt
@@ -76,7 +78,8 @@ class ConditionalStmt : public Stmt
   public:
     ConditionalStmt() : Stmt(), test(NULL), body(NULL) {}
     ConditionalStmt(Expr *testExpr, Stmt *body);
-    virtual llvm::Value* Emit() { return NULL; }
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx) { return NULL; }
 };
 
 class LoopStmt : public ConditionalStmt 
@@ -84,7 +87,7 @@ class LoopStmt : public ConditionalStmt
   public:
     LoopStmt(Expr *testExpr, Stmt *body)
             : ConditionalStmt(testExpr, body) {}
-    virtual llvm::Value* Emit();
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class ForStmt : public LoopStmt 
@@ -96,7 +99,8 @@ class ForStmt : public LoopStmt
     ForStmt(Expr *init, Expr *test, Expr *step, Stmt *body);
     const char *GetPrintNameForNode() { return "ForStmt"; }
     void PrintChildren(int indentLevel);
-    virtual llvm::Value* Emit();
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class WhileStmt : public LoopStmt 
@@ -105,7 +109,7 @@ class WhileStmt : public LoopStmt
     WhileStmt(Expr *test, Stmt *body) : LoopStmt(test, body) {}
     const char *GetPrintNameForNode() { return "WhileStmt"; }
     void PrintChildren(int indentLevel);
-    virtual llvm:: Value* Emit();
+    virtual llvm:: Value* Emit(CompilationContext *ctx);
 };
 
 class IfStmt : public ConditionalStmt 
@@ -118,13 +122,14 @@ class IfStmt : public ConditionalStmt
     IfStmt(Expr *test, Stmt *thenBody, Stmt *elseBody);
     const char *GetPrintNameForNode() { return "IfStmt"; }
     void PrintChildren(int indentLevel);
-    virtual llvm::Value* Emit();
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class IfStmtExprError : public IfStmt
 {
   public:
-    IfStmtExprError() : IfStmt() { yyerror(this->GetPrintNameForNode()); }
+    IfStmtExprError();
     const char *GetPrintNameForNode() { return "IfStmtExprError"; }
 };
 
@@ -133,7 +138,7 @@ class BreakStmt : public Stmt
   public:
     BreakStmt(yyltype loc) : Stmt(loc) {}
     const char *GetPrintNameForNode() { return "BreakStmt"; }
-    virtual llvm::Value* Emit();
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class ContinueStmt : public Stmt 
@@ -141,7 +146,7 @@ class ContinueStmt : public Stmt
   public:
     ContinueStmt(yyltype loc) : Stmt(loc) {}
     const char *GetPrintNameForNode() { return "ContinueStmt"; }
-    virtual llvm::Value* Emit();
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class ReturnStmt : public Stmt  
@@ -153,7 +158,8 @@ class ReturnStmt : public Stmt
     ReturnStmt(yyltype loc, Expr *expr = NULL);
     const char *GetPrintNameForNode() { return "ReturnStmt"; }
     void PrintChildren(int indentLevel);
-    virtual llvm::Value* Emit();
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class SwitchLabel : public Stmt
@@ -167,7 +173,8 @@ class SwitchLabel : public Stmt
     SwitchLabel(Expr *label, Stmt *stmt);
     SwitchLabel(Stmt *stmt);
     void PrintChildren(int indentLevel);
-    virtual llvm::Value *Emit();
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value *Emit(CompilationContext *ctx);
     Expr* returnLabel() { return label; }
 };
 
@@ -177,7 +184,6 @@ class Case : public SwitchLabel
     Case() : SwitchLabel() {}
     Case(Expr *label, Stmt *stmt) : SwitchLabel(label, stmt) {}
     const char *GetPrintNameForNode() { return "Case"; }
-    virtual llvm::Value *Emit();
 };
 
 class Default : public SwitchLabel
@@ -185,7 +191,6 @@ class Default : public SwitchLabel
   public:
     Default(Stmt *stmt) : SwitchLabel(stmt) {}
     const char *GetPrintNameForNode() { return "Default"; }
-    virtual llvm::Value* Emit();
 };
 
 class SwitchStmt : public Stmt
@@ -200,15 +205,16 @@ class SwitchStmt : public Stmt
     SwitchStmt(Expr *expr, List<Stmt*> *cases, Default *def);
     virtual const char *GetPrintNameForNode() { return "SwitchStmt"; }
     void PrintChildren(int indentLevel);
-    virtual llvm::Value* Emit();
+    void Resolve(CompilationContext *ctx);
+    virtual llvm::Value* Emit(CompilationContext *ctx);
 };
 
 class SwitchStmtError : public SwitchStmt
 {
   public:
-    SwitchStmtError(const char * msg) { yyerror(msg); }
+    SwitchStmtError(const char * msg);
     const char *GetPrintNameForNode() { return "SwitchStmtError"; }
-    virtual llvm::Value* Emit() { return NULL; }
+    virtual llvm::Value* Emit(CompilationContext *ctx) { return NULL; }
 };
 
 #endif
@@ -15,36 +15,37 @@
  * creates lots of copies.
  */
 
-Type *Type::intType    = new Type("int");
-Type *Type::floatType  = new Type("float");
-Type *Type::voidType   = new Type("void");
-Type *Type::boolType   = new Type("bool");
-Type *Type::mat2Type   = new Type("mat2");
-Type *Type::mat3Type   = new Type("mat3");
-Type *Type::mat4Type   = new Type("mat4");
-Type *Type::vec2Type   = new Type("vec2");
-Type *Type::vec3Type   = new Type("vec3");
-Type *Type::vec4Type   = new Type("vec4");
-Type *Type::ivec2Type = new Type("ivec2");
-Type *Type::ivec3Type = new Type("ivec3");
-Type *Type::ivec4Type = new Type("ivec4");
-Type *Type::bvec2Type = new Type("bvec2");
-Type *Type::bvec3Type = new Type("bvec3");
-Type *Type::bvec4Type = new Type("bvec4");
-Type *Type::uintType = new Type("uint");
-Type *Type::uvec2Type = new Type("uvec2");
-Type *Type::uvec3Type = new Type("uvec3");
-Type *Type::uvec4Type = new Type("uvec4");
-Type *Type::errorType  = new Type("error"); 
+Type *Type::intType    = new Type("int", TypeInt);
+Type *Type::floatType  = new Type("float", TypeFloat);
+Type *Type::voidType   = new Type("void", TypeVoid);
+Type *Type::boolType   = new Type("bool", TypeBool);
+Type *Type::mat2Type   = new Type("mat2", TypeMat2);
+Type *Type::mat3Type   = new Type("mat3", TypeMat3);
+Type *Type::mat4Type   = new Type("mat4", TypeMat4);
+Type *Type::vec2Type   = new Type("vec2", TypeVec2);
+Type *Type::vec3Type   = new Type("vec3", TypeVec3);
+Type *Type::vec4Type   = new Type("vec4", TypeVec4);
+Type *Type::ivec2Type = new Type("ivec2", TypeIvec2);
+Type *Type::ivec3Type = new Type("ivec3", TypeIvec3);
+Type *Type::ivec4Type = new Type("ivec4", TypeIvec4);
+Type *Type::bvec2Type = new Type("bvec2", TypeBvec2);
+Type *Type::bvec3Type = new Type("bvec3", TypeBvec3);
+Type *Type::bvec4Type = new Type("bvec4", TypeBvec4);
+Type *Type::uintType = new Type("uint", TypeUint);
+Type *Type::uvec2Type = new Type("uvec2", TypeUvec2);
+Type *Type::uvec3Type = new Type("uvec3", TypeUvec3);
+Type *Type::uvec4Type = new Type("uvec4", TypeUvec4);
+Type *Type::errorType  = new Type("error", TypeError); 
 
 TypeQualifier *TypeQualifier::inTypeQualifier  = new TypeQualifier("in");
 TypeQualifier *TypeQualifier::outTypeQualifier = new TypeQualifier("out");
 TypeQualifier *TypeQualifier::constTypeQualifier = new TypeQualifier("const");
 TypeQualifier *TypeQualifier::uniformTypeQualifier = new TypeQualifier("uniform");
 
-Type::Type(const char *n) {
+Type::Type(const char *n, TypeTag t) {
     Assert(n);
     typeName = strdup(n);
+    tag = t;
 }
 
 void Type::PrintChildren(int indentLevel) {
@@ -61,26 +62,71 @@ void TypeQualifier::PrintChildren(int indentLevel) {
 }
 
 bool Type::IsNumeric() { 
-    return this->IsEquivalentTo(Type::intType) || this->IsEquivalentTo(Type::floatType);
+    return tag == TypeInt || tag == TypeUint || tag == TypeFloat;
 }
 
 bool Type::IsVector() { 
-    return this->IsEquivalentTo(Type::vec2Type) || 
-           this->IsEquivalentTo(Type::vec3Type) ||  
-           this->IsEquivalentTo(Type::vec4Type);
+    return tag >= TypeVec2 && tag <= TypeBvec4;
 }
 
 bool Type::IsMatrix() { 
-    return this->IsEquivalentTo(Type::mat2Type) || 
-           this->IsEquivalentTo(Type::mat3Type) ||  
-           this->IsEquivalentTo(Type::mat4Type);
+    return tag >= TypeMat2 && tag <= TypeMat4;
 }
 
 bool Type::IsError() { 
     return this->IsEquivalentTo(Type::errorType);
 }
+
+Type *Type::GetComponentType() {
+    switch (tag) {
+      case TypeVec2: case TypeVec3: case TypeVec4:
+      case TypeMat2: case TypeMat3: case TypeMat4:
+        return Type::floatType;
+      case TypeIvec2: case TypeIvec3: case TypeIvec4:
+        return Type::intType;
+      case TypeUvec2: case TypeUvec3: case TypeUvec4:
+        return Type::uintType;
+      case TypeBvec2: case TypeBvec3: case TypeBvec4:
+        return Type::boolType;
+      default:
+        return this;
+    }
+}
+
+int Type::NumComponents() {
+    switch (tag) {
+      case TypeVec2: case TypeIvec2: case TypeUvec2: case TypeBvec2: case TypeMat2:
+        return 2;
+      case TypeVec3: case TypeIvec3: case TypeUvec3: case TypeBvec3: case TypeMat3:
+        return 3;
+      case TypeVec4: case TypeIvec4: case TypeUvec4: case TypeBvec4: case TypeMat4:
+        return 4;
+      default:
+        return 1;
+    }
+}
+
+Type *Type::VectorOf(Type *component, int n) {
+    static Type **vectors[][3] = {
+      { &vec2Type,  &vec3Type,  &vec4Type  },
+      { &ivec2Type, &ivec3Type, &ivec4Type },
+      { &uvec2Type, &uvec3Type, &uvec4Type },
+      { &bvec2Type, &bvec3Type, &bvec4Type },
+    };
+    if (n == 1)
+      return component;
+    if (n < 2 || n > 4)
+      return errorType;
+    switch (component->GetTag()) {
+      case TypeFloat: return *vectors[0][n-2];
+      case TypeInt:   return *vectors[1][n-2];
+      case TypeUint:  return *vectors[2][n-2];
+      case TypeBool:  return *vectors[3][n-2];
+      default:        return errorType;
+    }
+}
 	
-NamedType::NamedType(Identifier *i) : Type(*i->GetLocation()) {
+NamedType::NamedType(Identifier *i) : Type(*i->GetLocation(), TypeNamed) {
     Assert(i != NULL);
     (id=i)->SetParent(this);
 } 
@@ -89,9 +135,9 @@ void NamedType::PrintChildren(int indentLevel) {
     id->Print(indentLevel+1);
 }
 
-ArrayType::ArrayType(yyltype loc, Type *et, int ec) : Type(loc) {
+ArrayType::ArrayType(yyltype loc, Type *et, int ec) : Type(loc, TypeArray) {
     Assert(et != NULL);
-    (elemType=et)->SetParent(this);
+    elemType = et;      // may be a shared built-in type, not reparented
     elemCount=ec;
 }
 void ArrayType::PrintChildren(int indentLevel) {
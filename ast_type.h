@@ -33,10 +33,28 @@ class TypeQualifier : public Node
     void PrintChildren(int indentLevel);
 };
 
+/* Enum: TypeTag
+ * -------------
+ * Identifies each built-in type, so facts about types (such as the LLVM
+ * type each one is lowered to, see IRGenerator::GetType) can be kept in
+ * tables indexed by it. Array and named types have a tag of their own.
+ */
+typedef enum {
+      TypeVoid, TypeBool, TypeInt, TypeUint, TypeFloat,
+      TypeVec2, TypeVec3, TypeVec4,
+      TypeIvec2, TypeIvec3, TypeIvec4,
+      TypeUvec2, TypeUvec3, TypeUvec4,
+      TypeBvec2, TypeBvec3, TypeBvec4,
+      TypeMat2, TypeMat3, TypeMat4,
+      TypeError, TypeArray, TypeNamed,
+      NumTypeTags
+} TypeTag;
+
 class Type : public Node 
 {
   protected:
     char *typeName;
+    TypeTag tag;
 
   public :
     static Type *intType, *uintType,*floatType, *boolType, *voidType,
@@ -47,8 +65,8 @@ class Type : public Node
                 *uvec2Type, *uvec3Type,*uvec4Type, 
                 *errorType;
 
-    Type(yyltype loc) : Node(loc) {}
-    Type(const char *str);
+    Type(yyltype loc, TypeTag t) : Node(loc), typeName(NULL), tag(t) {}
+    Type(const char *str, TypeTag t);
     
     const char *GetPrintNameForNode() { return "Type"; }
     void PrintChildren(int indentLevel);
@@ -57,10 +75,19 @@ class Type : public Node
     friend ostream& operator<<(ostream& out, Type *t) { t->PrintToStream(out); return out; }
     virtual bool IsEquivalentTo(Type *other) { return (this == other); }
     virtual bool IsConvertibleTo(Type *other) { return (this == other || this == errorType); }
-    bool IsNumeric();
-    bool IsVector();
+    TypeTag GetTag() { return tag; }
+    bool IsNumeric();   // int, uint or float
+    bool IsVector();    // a vector of any component type
     bool IsMatrix();
     bool IsError();
+
+    // The type of the components of a vector (float for the columns of a
+    // matrix, as they are vectors of floats), the type itself for others
+    Type *GetComponentType();
+    // 2 to 4 for vectors and matrices (columns), 1 for everything else
+    int NumComponents();
+    // the vector of n components of type component, component if n is 1
+    static Type *VectorOf(Type *component, int n);
 };
 
 
@@ -90,6 +117,7 @@ class ArrayType : public Type
     void PrintChildren(int indentLevel);
     void PrintToStream(ostream& out) { out << elemType << "[]"; }
     Type *GetElemType() {return elemType;}
+    int GetElemCount() {return elemCount;}
 };
 
  
@@ -0,0 +1,13 @@
+/* File: atom.cc
+ * -------------
+ * Implementation of the AtomTable class.
+ */
+
+#include "atom.h"
+
+Atom AtomTable::Intern(llvm::StringRef spelling) {
+    llvm::StringMapEntry<char> &entry =
+      *table.insert(std::make_pair(spelling, char(0))).first;
+    Atom atom = { entry.getKeyData(), (unsigned)entry.getKeyLength() };
+    return atom;
+}
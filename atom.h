@@ -0,0 +1,63 @@
+/* File: atom.h
+ * ------------
+ * This file defines the interned identifiers of a compilation. The
+ * scanner looks up the spelling of every identifier it reads in the
+ * AtomTable of the CompilationContext once, and from then on the
+ * Identifier nodes, the symbol table and the IR naming code pass around
+ * the Atom it returns: equal spellings always give the same Atom, so
+ * comparing and hashing names costs a pointer compare and hash.
+ */
+
+#ifndef _H_atom
+#define _H_atom
+
+#include <stdlib.h>   // for NULL
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+/* Struct: Atom
+ * ------------
+ * The one copy of a spelling kept by an AtomTable. It has no constructor
+ * so it can be passed in the parser's value union.
+ */
+struct Atom
+{
+    const char *name;    // null terminated, owned by the table
+    unsigned length;
+
+    llvm::StringRef str() const { return llvm::StringRef(name, length); }
+    bool operator==(Atom other) const { return name == other.name; }
+    bool operator!=(Atom other) const { return name != other.name; }
+};
+
+class AtomTable
+{
+  public:
+    // The atom for spelling, added to the table the first time it is seen
+    Atom Intern(llvm::StringRef spelling);
+    int NumAtoms() const { return table.size(); }
+
+  private:
+    llvm::StringMap<char> table;    // only the keys are used
+};
+
+namespace llvm {
+// lets atoms be keys of DenseMaps, hashed by address
+template<> struct DenseMapInfo<Atom> {
+    static Atom getEmptyKey() {
+      Atom a = { DenseMapInfo<const char *>::getEmptyKey(), 0 };
+      return a;
+    }
+    static Atom getTombstoneKey() {
+      Atom a = { DenseMapInfo<const char *>::getTombstoneKey(), 0 };
+      return a;
+    }
+    static unsigned getHashValue(Atom a) {
+      return DenseMapInfo<const char *>::getHashValue(a.name);
+    }
+    static bool isEqual(Atom a, Atom b) { return a == b; }
+};
+}
+
+#endif
@@ -0,0 +1,147 @@
+/* File: cache.cc
+ * --------------
+ * Implementation of the on-disk compilation cache.
+ */
+
+#include "cache.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include <algorithm>
+#include <vector>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// bump when the layout of the cache changes; changes to the generated
+// code are covered by GLC_BUILD_ID
+static const char *CacheVersion = "glc-cache-1";
+
+// set by the Makefile to a hash of the compiler's sources
+#ifndef GLC_BUILD_ID
+#define GLC_BUILD_ID "unknown"
+#endif
+static const char *TempPrefix = ".tmp-";
+
+CompileCache::CompileCache(const char *d, uint64_t max) :
+    dir(d ? d : ""),
+    maxBytes(max)
+{
+    if (!dir.empty())
+      mkdir(dir.c_str(), 0777);   // fails harmlessly if it exists
+}
+
+std::string CompileCache::Key(llvm::StringRef source, const Options &opts) {
+    std::string triple = llvm::sys::getDefaultTargetTriple();
+    std::string cpu = opts.cpu ? opts.cpu : "generic";
+    if (cpu == "native")
+      cpu = llvm::sys::getHostCPUName();
+    char level[2] = { (char)('0' + opts.optLevel), '\0' };
+    const char *ext = (opts.emit == EmitObject) ? ".o" :
+                      (opts.emit == EmitAssembly) ? ".s" : ".bc";
+
+    llvm::MD5 hash;
+    const char *ir = opts.buildSSA ? "ssa" : "alloca";
+    const char *fields[] = { CacheVersion, GLC_BUILD_ID, LLVM_VERSION_STRING,
+                             triple.c_str(), cpu.c_str(), level, ir, ext };
+    for (int i = 0; i < sizeof(fields)/sizeof(fields[0]); i++) {
+      hash.update(llvm::StringRef(fields[i]));
+      hash.update(llvm::StringRef("", 1));   // keeps the fields apart
+    }
+    hash.update(source);
+
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    llvm::SmallString<32> digest;
+    llvm::MD5::stringifyResult(result, digest);
+    return std::string(digest.str()) + ext;
+}
+
+std::string CompileCache::PathOf(const std::string &key) const {
+    return dir + "/" + key;
+}
+
+std::unique_ptr<llvm::MemoryBuffer> CompileCache::Lookup(const std::string &key) {
+    if (dir.empty())
+      return NULL;
+    std::string path = PathOf(key);
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > buffer =
+      llvm::MemoryBuffer::getFile(path, -1, false);
+    if (!buffer)
+      return NULL;
+    utimes(path.c_str(), NULL);   // most recently used now
+    return std::move(*buffer);
+}
+
+bool CompileCache::Store(const std::string &key, llvm::StringRef data) {
+    if (dir.empty())
+      return false;
+    std::string temp = dir + "/" + TempPrefix + "XXXXXX";
+    int fd = mkstemp(&temp[0]);
+    if (fd < 0)
+      return false;
+
+    const char *p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+      ssize_t n = write(fd, p, left);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      p += n;
+      left -= n;
+    }
+    fchmod(fd, 0644);
+    close(fd);
+    if (left > 0 || rename(temp.c_str(), PathOf(key).c_str()) != 0) {
+      unlink(temp.c_str());
+      return false;
+    }
+    Evict();
+    return true;
+}
+
+struct CacheEntry {
+    std::string path;
+    uint64_t size;
+    time_t mtime;
+    bool operator<(const CacheEntry &other) const { return mtime < other.mtime; }
+};
+
+/* Removes the least recently used entries until the total size is within
+ * the bound. Temporary files of other writers are left alone.
+ */
+void CompileCache::Evict() {
+    DIR *d = opendir(dir.c_str());
+    if (d == NULL)
+      return;
+    std::vector<CacheEntry> entries;
+    uint64_t total = 0;
+    while (struct dirent *e = readdir(d)) {
+      if (e->d_name[0] == '.')
+        continue;   // ., .. and temporaries
+      CacheEntry entry;
+      entry.path = dir + "/" + e->d_name;
+      struct stat st;
+      if (stat(entry.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        continue;
+      entry.size = st.st_size;
+      entry.mtime = st.st_mtime;
+      entries.push_back(entry);
+      total += entry.size;
+    }
+    closedir(d);
+    if (total <= maxBytes)
+      return;
+
+    std::sort(entries.begin(), entries.end());
+    for (int i = 0; i < entries.size() && total > maxBytes; i++) {
+      if (unlink(entries[i].path.c_str()) == 0)
+        total -= entries[i].size;
+    }
+}
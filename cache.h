@@ -0,0 +1,54 @@
+/* File: cache.h
+ * -------------
+ * This file defines the CompileCache class, a content-addressed cache of
+ * compiler output on disk. An entry is named after a hash of everything
+ * that determines the output: the source text, the options that change
+ * code generation, the target triple and cpu, the LLVM version and the
+ * build of the compiler itself (GLC_BUILD_ID, a hash of its sources
+ * computed by the Makefile), so a new compiler never reuses output of an
+ * older one. A hit costs one hash of the source and a mapping of the
+ * cached file, and skips the scanner, the parser and Emit entirely.
+ *
+ * Entries are written to a temporary file in the cache directory and
+ * renamed into place, so concurrent compilers (or a crash) never leave a
+ * partial entry behind. After each store the least recently used entries
+ * are evicted until the cache fits in its size bound; hits refresh the
+ * modification time of their entry.
+ */
+
+#ifndef _H_cache
+#define _H_cache
+
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include "options.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+class CompileCache
+{
+  public:
+    CompileCache(const char *dir, uint64_t maxBytes);
+
+    // The name of the entry holding the output for source compiled
+    // with opts
+    static std::string Key(llvm::StringRef source, const Options &opts);
+
+    // Returns the cached output for key (memory mapped when the file is
+    // large enough for that to pay off), or NULL on a miss
+    std::unique_ptr<llvm::MemoryBuffer> Lookup(const std::string &key);
+
+    // Atomically installs data as the entry for key, then evicts the
+    // oldest entries if the cache grew beyond its bound
+    bool Store(const std::string &key, llvm::StringRef data);
+
+  protected:
+    void Evict();
+    std::string PathOf(const std::string &key) const;
+
+    std::string dir;
+    uint64_t maxBytes;
+};
+
+#endif
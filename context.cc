@@ -0,0 +1,140 @@
+/* File: context.cc
+ * ----------------
+ * Implementation of the CompilationContext class.
+ */
+
+#include "context.h"
+#include "arena.h"
+#include "atom.h"
+#include "parser.h"
+#include "errors.h"
+#include "irgen.h"
+#include "symtable.h"
+#include "timing.h"
+#include "utility.h"
+#include <string.h>
+#include <algorithm>
+
+#define TAB_SIZE 8
+
+thread_local CompilationContext *CompilationContext::current = NULL;
+
+CompilationContext::CompilationContext(const Options &opts,
+                                       llvm::LLVMContext *llvmContext) :
+    curOffset(0),
+    options(opts),
+    program(NULL),
+    numErrors(0),
+    diagnostics(NULL),
+    timeReport(NULL)
+{
+    arena = new Arena();
+    atoms = new AtomTable();
+    if (IsDebugOn("time-report") || IsDebugOn("time-report-json"))
+        timeReport = new TimeReport();
+
+    irgen = new IRGenerator();
+    symtable = new Symtable();
+    irgen->SetTarget(options.cpu, options.optLevel);
+    irgen->SetBuildSSA(options.buildSSA);
+    if (llvmContext != NULL)
+        irgen->SetContext(llvmContext);
+
+    // contexts nest on a thread, e.g. a context created while another
+    // one is compiling; the outer one is restored by the destructor
+    previous = current;
+    current = this;
+}
+
+CompilationContext::~CompilationContext() {
+    if (timeReport) {
+        if (IsDebugOn("time-report")) timeReport->Print(stderr);
+        if (IsDebugOn("time-report-json")) timeReport->PrintJSON(stderr);
+        delete timeReport;
+    }
+    current = previous;
+    for (int i = 0; i < savedLines.size(); i++)
+        free((void *)savedLines[i]);
+    delete symtable;
+    delete irgen;
+    if (IsDebugOn("arena")) arena->PrintStats(stderr);
+    delete arena;
+    delete atoms;
+}
+
+/* Returns string with contents of line numbered n or NULL if the
+ * contents of that line are not available. The scanner copies each
+ * line scanned and appends each to savedLines so we can later retrieve
+ * them to report the context for errors.
+ */
+const char *CompilationContext::GetLineNumbered(int num) const {
+    if (num <= 0 || num > savedLines.size()) return NULL;
+    return savedLines[num-1];
+}
+
+int CompilationContext::LineOf(SourceLoc loc) const {
+    return std::upper_bound(lineStarts.begin(), lineStarts.end(), loc)
+           - lineStarts.begin();
+}
+
+/* Columns count bytes from 1, except that a tab moves on to the column
+ * after the next multiple of TAB_SIZE, so the carets printed under a
+ * line with tabs line up with it.
+ */
+int CompilationContext::ColumnOf(SourceLoc loc) const {
+    int line = LineOf(loc);
+    if (line == 0) return 1;
+    SourceLoc start = lineStarts[line-1];
+    const char *text = GetLineNumbered(line);
+    SourceLoc len = text ? strlen(text) : 0;
+    int col = 1;
+    for (SourceLoc i = 0; i < loc - start; i++) {
+        col++;
+        if (i < len && text[i] == '\t')
+            col += TAB_SIZE - col%TAB_SIZE + 1;
+    }
+    return col;
+}
+
+Program *CompilationContext::Parse(FILE *in) {
+    return RunParser(InitScanner(this, in));
+}
+
+Program *CompilationContext::Parse(const char *text, int len) {
+    return RunParser(InitScanner(this, text, len));
+}
+
+Program *CompilationContext::RunParser(void *scanner) {
+    {
+        PhaseTimer timer(timeReport, "parse");
+        yyparse(this, scanner);
+    }
+    FreeScanner(scanner);
+    return (numErrors == 0) ? program : NULL;
+}
+
+bool CompilationContext::Compile(FILE *in) {
+    return Parse(in) != NULL && Analyze() && EmitProgram();
+}
+
+bool CompilationContext::Compile(const char *text, int len) {
+    return Parse(text, len) != NULL && Analyze() && EmitProgram();
+}
+
+bool CompilationContext::Analyze() {
+    PhaseTimer timer(timeReport, "analyze");
+    program->Resolve(this);
+    return numErrors == 0;
+}
+
+bool CompilationContext::EmitProgram() {
+    {
+        PhaseTimer timer(timeReport, "emit");
+        program->Emit(this);
+    }
+    if (numErrors != 0)
+        return false;
+    PhaseTimer timer(timeReport, "optimize");
+    irgen->Optimize(options.optLevel);
+    return true;
+}
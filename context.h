@@ -0,0 +1,126 @@
+/* File: context.h
+ * ---------------
+ * This file defines the CompilationContext class, which owns all of the
+ * state of compiling one translation unit: the options, the reentrant
+ * scanner and its saved source lines, the symbol table, the IR generator
+ * (and with it the LLVMContext and the module), the arena holding the
+ * parse tree, the interned identifiers and the error count. No
+ * two contexts share any mutable state, so separate compilations can run
+ * concurrently on different threads of one process.
+ *
+ * The context is passed explicitly to the parser (as its parse-param) and
+ * to every Emit() call. ReportError, whose interface is static, finds the
+ * context compiling on the calling thread through Current().
+ */
+
+#ifndef _H_context
+#define _H_context
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "options.h"
+#include "location.h"
+
+namespace llvm { class LLVMContext; }
+class IRGenerator;
+class Symtable;
+class Program;
+class TimeReport;
+class Arena;
+class AtomTable;
+
+/* Struct: Diagnostics
+ * -------------------
+ * Collects the errors of a compilation instead of printing them to
+ * stderr, for callers of the library interface (see glc.h).
+ */
+struct Diagnostics
+{
+    int numErrors;
+    std::string messages;   // the error reports, worded as glc prints them
+
+    Diagnostics() : numErrors(0) {}
+};
+
+class CompilationContext
+{
+  public:
+    // The module is built in llvmContext if one is given (it must outlive
+    // the module), otherwise the IRGenerator creates a context of its own
+    CompilationContext(const Options &options, llvm::LLVMContext *llvmContext = NULL);
+    ~CompilationContext();
+
+    // Scans and parses the program read from in (or held in the len bytes
+    // at text). Returns the tree, or NULL if any errors were reported.
+    // The tree lives in the arena and is freed with the context.
+    Program *Parse(FILE *in);
+    Program *Parse(const char *text, int len);
+
+    // Parses the program, binds its names (see Program::Resolve), emits
+    // it into the module and runs the optimization pipeline. Returns
+    // false if any errors were reported.
+    bool Compile(FILE *in);
+    bool Compile(const char *text, int len);
+
+    const Options &GetOptions() const { return options; }
+    IRGenerator *GetIRGenerator() const { return irgen; }
+    Symtable *GetSymtable() const { return symtable; }
+
+    Program *GetProgram() const { return program; }
+    void SetProgram(Program *p) { program = p; }
+
+    // Error bookkeeping used by ReportError. Errors go to stderr unless
+    // a Diagnostics sink is set.
+    int NumErrors() const { return numErrors; }
+    void CountError() { numErrors++; }
+    const char *GetLineNumbered(int num) const;
+
+    // Line and column of the character at loc, decoded from the line
+    // starts recorded by the scanner. Tabs advance the column to the next
+    // tab stop.
+    int LineOf(SourceLoc loc) const;
+    int ColumnOf(SourceLoc loc) const;
+    Diagnostics *GetDiagnostics() const { return diagnostics; }
+    void SetDiagnostics(Diagnostics *d) { diagnostics = d; }
+
+    // The phase timings (see timing.h), NULL unless -d time-report or
+    // -d time-report-json is on. Printed when the context is destroyed.
+    TimeReport *GetTimeReport() const { return timeReport; }
+
+    // The arena the parse tree is allocated in (see arena.h), released
+    // with the context
+    Arena *GetArena() const { return arena; }
+
+    // The interned identifiers (see atom.h)
+    AtomTable *GetAtoms() const { return atoms; }
+
+    // The context compiling on the calling thread, NULL if there is none
+    static CompilationContext *Current() { return current; }
+
+    // Position bookkeeping updated by the scanner actions in scanner.l:
+    // the offset of the next character and where each line starts
+    SourceLoc curOffset;
+    std::vector<SourceLoc> lineStarts;
+    std::vector<const char*> savedLines;
+
+  protected:
+    Program *RunParser(void *scanner);
+    bool Analyze();
+    bool EmitProgram();
+
+    Options options;
+    IRGenerator *irgen;
+    Symtable *symtable;
+    Program *program;
+    int numErrors;
+    Diagnostics *diagnostics;
+    TimeReport *timeReport;
+    Arena *arena;
+    AtomTable *atoms;
+
+    CompilationContext *previous;    // restored as current when done
+    static thread_local CompilationContext *current;
+};
+
+#endif
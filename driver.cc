@@ -0,0 +1,166 @@
+/* File: driver.cc
+ * ---------------
+ * Implementation of output writing and batch compilation.
+ */
+
+#include "driver.h"
+#include "errors.h"
+#include "context.h"
+#include "cache.h"
+#include "timing.h"
+#include "trace.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetSelect.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+bool WriteOutput(IRGenerator *irgen, const Options &opts, llvm::raw_ostream &out) {
+    if (opts.emit != EmitBitcode)
+      return irgen->EmitNative(out, opts.emit == EmitAssembly);
+    llvm::WriteBitcodeToFile(irgen->GetModule(), out);
+    out.flush();
+    return true;
+}
+
+WorkerState::~WorkerState() {
+    for (auto &entry : targetMachines)
+      delete entry.second;
+    delete context;
+}
+
+llvm::LLVMContext *WorkerState::NextContext() {
+    if (context == NULL || uses == ContextReuseLimit) {
+      delete context;
+      context = new llvm::LLVMContext();
+      uses = 0;
+    }
+    uses++;
+    return context;
+}
+
+llvm::TargetMachine *WorkerState::GetTargetMachine(const char *cpu, int optLevel) {
+    std::pair<std::string, int> key(cpu ? cpu : "", optLevel);
+    std::map<std::pair<std::string, int>, llvm::TargetMachine*>::iterator it =
+      targetMachines.find(key);
+    if (it != targetMachines.end())
+      return it->second;
+    llvm::TargetMachine *tm = IRGenerator::CreateTargetMachine(cpu, optLevel);
+    targetMachines[key] = tm;
+    return tm;
+}
+
+bool CompileSource(llvm::StringRef source, const Options &opts,
+                   llvm::raw_ostream &out, Diagnostics *diags,
+                   WorkerState *worker) {
+    CompileCache cache(opts.cacheDir, opts.cacheSize);
+    std::string key;
+    if (opts.cacheDir) {
+      key = CompileCache::Key(source, opts);
+      std::unique_ptr<llvm::MemoryBuffer> hit = cache.Lookup(key);
+      if (hit) {
+        out << hit->getBuffer();
+        out.flush();
+        return true;
+      }
+    }
+
+    CompilationContext ctx(opts, worker ? worker->NextContext() : NULL);
+    if (worker) {
+      if (llvm::TargetMachine *tm = worker->GetTargetMachine(opts.cpu, opts.optLevel))
+        ctx.GetIRGenerator()->SetTargetMachine(tm);
+    }
+    ctx.SetDiagnostics(diags);
+    bool ok = ctx.Compile(source.data(), source.size());
+    if (ok) {
+      // with a cache the output is built in memory so it can be stored
+      llvm::SmallVector<char, 0> buffer;
+      llvm::raw_svector_ostream os(buffer);
+      PhaseTimer timer(ctx.GetTimeReport(), "write");
+      ok = WriteOutput(ctx.GetIRGenerator(), opts, opts.cacheDir ? os : out);
+      if (!ok)
+        ReportError::Formatted(NULL, "Cannot generate code for the host target");
+      else if (opts.cacheDir) {
+        cache.Store(key, os.str());
+        out << os.str();
+        out.flush();
+      }
+    }
+    if (diags)
+      diags->numErrors += ctx.NumErrors();
+    return ok;
+}
+
+static std::string OutputName(const char *input, emitT emit) {
+    std::string name(input);
+    size_t dot = name.rfind('.');
+    size_t slash = name.rfind('/');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+      name.erase(dot);
+    if (emit == EmitObject) name += ".o";
+    else if (emit == EmitAssembly) name += ".s";
+    else name += ".bc";
+    return name;
+}
+
+static bool CompileFile(const char *input, const Options &opts, WorkerState *worker) {
+    TraceSpan span("batch", input);
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > source =
+      llvm::MemoryBuffer::getFile(input);
+    if (!source) {
+      ReportError::Formatted(NULL, "Cannot open input file '%s'", input);
+      return false;
+    }
+
+    std::string output = OutputName(input, opts.emit);
+    std::error_code ec;
+    bool ok;
+    {
+      llvm::raw_fd_ostream out(output, ec, llvm::sys::fs::F_None);
+      if (ec)
+        ReportError::Formatted(NULL, "Cannot write output for '%s': %s",
+                               input, ec.message().c_str());
+      ok = !ec && CompileSource((*source)->getBuffer(), opts, out, NULL, worker);
+    }
+    if (!ok && !ec)
+      llvm::sys::fs::remove(output);   // no partial output
+    if (!ok)
+      ReportError::Formatted(NULL, "Compilation of '%s' failed", input);
+    return ok;
+}
+
+int CompileBatch(const Options &opts) {
+    // register the targets once, before any worker looks them up
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+
+    int numInputs = opts.inputs.size();
+    int jobs = opts.jobs > 0 ? opts.jobs : 1;
+    if (jobs > numInputs) jobs = numInputs;
+    std::atomic<int> next(0);
+    std::atomic<int> failed(0);
+
+    auto worker = [&](int id) {
+      SetTraceThreadName(id == 0 ? "main" : "worker " + std::to_string(id));
+      TraceSpan span("batch", "worker");
+      // the thread's context and target machines serve all its files
+      WorkerState state;
+      for (int i = next++; i < numInputs; i = next++) {
+        if (!CompileFile(opts.inputs[i], opts, &state))
+          failed++;
+      }
+    };
+
+    std::vector<std::thread> pool;
+    for (int j = 1; j < jobs; j++)
+      pool.push_back(std::thread(worker, j));
+    worker(0);
+    for (int j = 0; j < pool.size(); j++)
+      pool[j].join();
+    return failed;
+}
@@ -0,0 +1,76 @@
+/* File: driver.h
+ * --------------
+ * This file declares the parts of the compiler driver that are shared by
+ * the single file mode in main.cc and the batch mode: writing the module
+ * in the requested output format, and compiling many source files in one
+ * process on a pool of worker threads.
+ */
+
+#ifndef _H_driver
+#define _H_driver
+
+#include "options.h"
+#include "irgen.h"
+#include "llvm/ADT/StringRef.h"
+#include <map>
+#include <string>
+
+struct Diagnostics;
+
+/* Class: WorkerState
+ * ------------------
+ * LLVM state kept by a thread that compiles one source after another:
+ * an LLVMContext, in which the built-in types are created once and then
+ * only looked up, and a TargetMachine for each cpu and optimization level
+ * asked for. The context is replaced after ContextReuseLimit compilations
+ * so the constants uniqued in it do not pile up.
+ */
+class WorkerState
+{
+  public:
+    WorkerState() : context(NULL), uses(0) {}
+    ~WorkerState();
+
+    // The context for the next compilation, which must be done with it
+    // before this is called again
+    llvm::LLVMContext *NextContext();
+    llvm::TargetMachine *GetTargetMachine(const char *cpu, int optLevel);
+
+  private:
+    static const int ContextReuseLimit = 1000;
+    llvm::LLVMContext *context;
+    int uses;
+    std::map<std::pair<std::string, int>, llvm::TargetMachine*> targetMachines;
+};
+
+/* Function: WriteOutput()
+ * -----------------------
+ * Writes the module built by irgen to out as bitcode, assembly or an
+ * object file, as selected by opts.emit. Returns false if the output
+ * could not be produced.
+ */
+bool WriteOutput(IRGenerator *irgen, const Options &opts, llvm::raw_ostream &out);
+
+/* Function: CompileSource()
+ * -------------------------
+ * Compiles source and writes the output selected by opts.emit to out.
+ * With opts.cacheDir set, the output is taken from the cache if this
+ * source was compiled with the same options before, and stored there
+ * otherwise. Errors go to diags if it is not NULL. The LLVM state of
+ * worker is used if one is given. Returns false if there were errors.
+ */
+bool CompileSource(llvm::StringRef source, const Options &opts,
+                   llvm::raw_ostream &out, Diagnostics *diags = NULL,
+                   WorkerState *worker = NULL);
+
+/* Function: CompileBatch()
+ * ------------------------
+ * Compiles every file in opts.inputs on opts.jobs worker threads (one
+ * if -j is not given) and writes <name>.bc (<name>.s or <name>.o with
+ * -emit=asm|obj) next to each source file. Every file is compiled in its own CompilationContext (see
+ * context.h), so the workers share no scanner, parser or LLVM state.
+ * Returns the number of files that could not be compiled.
+ */
+int CompileBatch(const Options &opts);
+
+#endif
@@ -11,33 +11,55 @@
 
 using namespace std;
 
-#include "scanner.h" // for GetLineNumbered
+#include "context.h" // for GetLineNumbered
 #include "ast_type.h"
 #include "ast_expr.h"
 #include "ast_stmt.h"
 #include "ast_decl.h"
 
-int ReportError::numErrors = 0;
+thread_local int ReportError::numErrors = 0;
 
-void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
+int ReportError::LineOf(Node *node) {
+    CompilationContext *ctx = CompilationContext::Current();
+    if (!ctx || !node->GetLocation()) return 0;
+    return ctx->LineOf(node->GetLocation()->begin);
+}
+
+void ReportError::UnderlineErrorInLine(ostream &out, const char *line, int first, int last) {
     if (!line) return;
-    cerr << line << endl;
-    for (int i = 1; i <= pos->last_column; i++)
-        cerr << (i >= pos->first_column ? '^' : ' ');
-    cerr << endl;
+    out << line << endl;
+    for (int i = 1; i <= last; i++)
+        out << (i >= first ? '^' : ' ');
+    out << endl;
 }
 
  
  
+/* The report goes to stderr, or to the Diagnostics of the compilation
+ * running on this thread if it has any (see context.h).
+ */
 void ReportError::OutputError(yyltype *loc, string msg) {
+    CompilationContext *ctx = CompilationContext::Current();
     numErrors++;
-    fflush(stdout); // make sure any buffered text has been output
-    if (loc) {
-        cerr << endl << "*** Error line " << loc->first_line << "." << endl;
-        UnderlineErrorInLine(GetLineNumbered(loc->first_line), loc);
+    if (ctx) ctx->CountError();
+    ostringstream report;
+    if (loc && ctx) {
+        // the only place lines and columns are needed, so they are
+        // decoded from the offsets here
+        int line = ctx->LineOf(loc->begin);
+        report << endl << "*** Error line " << line << "." << endl;
+        UnderlineErrorInLine(report, ctx->GetLineNumbered(line),
+                             ctx->ColumnOf(loc->begin), ctx->ColumnOf(loc->end));
     } else
-        cerr << endl << "*** Error." << endl;
-    cerr << "*** " << msg << endl << endl;
+        report << endl << "*** Error." << endl;
+    report << "*** " << msg << endl << endl;
+
+    if (ctx && ctx->GetDiagnostics()) {
+        ctx->GetDiagnostics()->messages += report.str();
+        return;
+    }
+    fflush(stdout); // make sure any buffered text has been output
+    cerr << report.str();
 }
 
 
@@ -77,7 +99,7 @@ void ReportError::UnrecogChar(yyltype *loc, char ch) {
 void ReportError::DeclConflict(Decl *decl, Decl *prevDecl) {
     ostringstream s;
     s << "Declaration of '" << decl << "' here conflicts with declaration on line " 
-      << prevDecl->GetLocation()->first_line;
+      << LineOf(prevDecl);
     OutputError(decl->GetLocation(), s.str());
 }
 
@@ -151,7 +173,7 @@ void ReportError::ReturnMismatch(ReturnStmt *rStmt, Type *given, Type *expected)
 void ReportError::ReturnMissing(FnDecl *fnDecl) {
     ostringstream s;
     s << "Declaration of '" << fnDecl << "' on line " 
-      << fnDecl->GetLocation()->first_line
+      << LineOf(fnDecl)
       << " doesn't have a return";
     OutputError(fnDecl->GetLocation(), s.str());
 }
@@ -200,9 +222,10 @@ void ReportError::ContinueOutsideLoop(ContinueStmt *cStmt) {
  * the last token read. If you want to suppress the ordinary "parse error"
  * message from yacc, you can implement yyerror to do nothing and
  * then call ReportError::Formatted yourself with a more descriptive 
- * message.
+ * message. Since the parser is pure, the location, the context and the
+ * scanner handle are passed in by yyparse().
  */
 
-void yyerror(const char *msg) {
-    ReportError::Formatted(&yylloc, "%s", msg);
+void yyerror(yyltype *loc, CompilationContext *ctx, void *scanner, const char *msg) {
+    ReportError::Formatted(loc, "%s", msg);
 }
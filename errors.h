@@ -30,7 +30,7 @@ using namespace std;
  * the class name, e.g.
  *
  *    if (missingEnd) { 
- *       ReportError::UntermString(&yylloc, str);
+ *       ReportError::UntermString(yylloc, str);
  *    }
  *
  * For some methods, the first argument is the pointer to the location
@@ -103,12 +103,14 @@ class ReportError {
   static void Formatted(yyltype *loc, const char *format, ...);
 
 
-  // Returns number of error messages printed
+  // Returns number of error messages printed on this thread. Errors are
+  // also counted by the CompilationContext compiling on the thread.
   static int NumErrors() { return numErrors; }
   
  private:
-  static void UnderlineErrorInLine(const char *line, yyltype *pos);
+  static void UnderlineErrorInLine(ostream &out, const char *line, int first, int last);
+  static int LineOf(Node *node);
   static void OutputError(yyltype *loc, string msg);
-  static int numErrors;
+  static thread_local int numErrors;
 };
 #endif
@@ -0,0 +1,42 @@
+/* File: glc.cc
+ * ------------
+ * Implementation of the library interface.
+ */
+
+#include "glc.h"
+#include "driver.h"
+#include "irgen.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include <mutex>
+
+// registers the native target once, before any compilation looks it up
+static void InitializeLibrary() {
+    static std::once_flag once;
+    std::call_once(once, []() {
+      llvm::InitializeNativeTarget();
+      llvm::InitializeNativeTargetAsmPrinter();
+      llvm::InitializeNativeTargetAsmParser();
+    });
+}
+
+std::unique_ptr<llvm::Module> CompileGLSL(llvm::StringRef source,
+                                          const Options &options,
+                                          Diagnostics &diags,
+                                          llvm::LLVMContext &context) {
+    InitializeLibrary();
+    CompilationContext ctx(options, &context);
+    ctx.SetDiagnostics(&diags);
+    bool ok = ctx.Compile(source.data(), source.size());
+    diags.numErrors += ctx.NumErrors();
+    if (!ok)
+      return std::unique_ptr<llvm::Module>();
+    return std::unique_ptr<llvm::Module>(ctx.GetIRGenerator()->ReleaseModule());
+}
+
+bool CompileGLSL(llvm::StringRef source, const Options &options,
+                 Diagnostics &diags, llvm::SmallVectorImpl<char> &output) {
+    InitializeLibrary();
+    llvm::raw_svector_ostream out(output);
+    return CompileSource(source, options, out, &diags);
+}
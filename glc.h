@@ -0,0 +1,42 @@
+/* File: glc.h
+ * -----------
+ * This file defines the interface of libglc, the compiler packaged as a
+ * library (make lib builds libglc.a and libglc.so). A program that links
+ * it compiles shader source held in memory without starting a glc
+ * process and piping the source through stdin.
+ *
+ * Every call compiles in its own CompilationContext, so calls from
+ * different threads may run at the same time. Errors are not printed;
+ * they are collected in the Diagnostics passed in.
+ */
+
+#ifndef _H_glc
+#define _H_glc
+
+#include <memory>
+#include "options.h"
+#include "context.h"   // for Diagnostics
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+/* Function: CompileGLSL()
+ * -----------------------
+ * Compiles source with the given options (optimization level, cpu) and
+ * returns the module, built in context, or NULL if there were errors.
+ */
+std::unique_ptr<llvm::Module> CompileGLSL(llvm::StringRef source,
+                                          const Options &options,
+                                          Diagnostics &diags,
+                                          llvm::LLVMContext &context);
+
+/* Same as above, except the module is written into output as bitcode
+ * (or as assembly or an object file, as selected by options.emit) and
+ * true is returned if that succeeded. This variant uses the cache in
+ * options.cacheDir if one is set.
+ */
+bool CompileGLSL(llvm::StringRef source, const Options &options,
+                 Diagnostics &diags, llvm::SmallVectorImpl<char> &output);
+
+#endif
@@ -5,29 +5,191 @@
 
 #include "irgen.h"
 #include "ast_type.h"
+#include "ast_decl.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetOptions.h"
 
 IRGenerator::IRGenerator() :
     context(NULL),
+    ownsContext(true),
     module(NULL),
     currentFunc(NULL),
-    currentBB(NULL)
+    builder(NULL),
+    buildSSA(true),
+    targetMachine(NULL),
+    ownsTargetMachine(true),
+    codegenLevel(0)
 {
 }
 
 IRGenerator::~IRGenerator() {
+   delete builder;
+   delete module;
+   if (ownsContext)
+     delete context;
+   if (ownsTargetMachine)
+     delete targetMachine;
+}
+
+void IRGenerator::SetContext(llvm::LLVMContext *ctx) {
+   if (ownsContext)
+     delete context;
+   context = ctx;
+   ownsContext = false;
+   typeTable.clear();
+   arrayTypes.clear();
+}
+
+llvm::Module *IRGenerator::ReleaseModule() {
+   llvm::Module *mod = module;
+   module = NULL;
+   return mod;
 }
 
 llvm::Module *IRGenerator::GetOrCreateModule(const char *moduleID)
 {
    if ( module == NULL ) {
-     context = new llvm::LLVMContext();
+     if (context == NULL)
+       context = new llvm::LLVMContext();
      module  = new llvm::Module(moduleID, *context);
-     module->setTargetTriple(TargetTriple);
-     module->setDataLayout(TargetLayout);
+     module->setTargetTriple(llvm::sys::getDefaultTargetTriple());
+     if (llvm::TargetMachine *tm = GetTargetMachine())
+       module->setDataLayout(tm->createDataLayout());
+     BuildTypeTable();
+     builder = new llvm::IRBuilder<>(*context);
    }
    return module;
 }
 
+void IRGenerator::SetTarget(const char *cpu, int optLevel) {
+   targetCPU = cpu ? cpu : "";
+   codegenLevel = optLevel;
+}
+
+void IRGenerator::SetTargetMachine(llvm::TargetMachine *tm) {
+   if (ownsTargetMachine)
+     delete targetMachine;
+   targetMachine = tm;
+   ownsTargetMachine = false;
+}
+
+// created on first use from the SetTarget() settings
+llvm::TargetMachine *IRGenerator::GetTargetMachine() {
+   if (targetMachine == NULL)
+     targetMachine = CreateTargetMachine(targetCPU.c_str(), codegenLevel);
+   return targetMachine;
+}
+
+/* The TargetMachine is for the host triple. With -mcpu=native the host
+ * cpu name and its feature set (AVX2, AVX-512, ...) are queried so vector
+ * types are lowered to the widest registers.
+ */
+llvm::TargetMachine *IRGenerator::CreateTargetMachine(const char *cpuName, int optLevel) {
+   llvm::InitializeNativeTarget();
+   llvm::InitializeNativeTargetAsmPrinter();
+   llvm::InitializeNativeTargetAsmParser();
+
+   std::string triple = llvm::sys::getDefaultTargetTriple();
+   std::string error;
+   const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+   if (target == NULL)
+     return NULL;
+
+   std::string cpu = (cpuName == NULL || *cpuName == '\0') ? "generic" : cpuName;
+   std::string features;
+   if (cpu == "native") {
+     cpu = llvm::sys::getHostCPUName();
+     llvm::StringMap<bool> hostFeatures;
+     if (llvm::sys::getHostCPUFeatures(hostFeatures)) {
+       for (llvm::StringMap<bool>::iterator it = hostFeatures.begin();
+            it != hostFeatures.end(); ++it) {
+         if (!features.empty()) features += ",";
+         features += (it->second ? "+" : "-") + it->getKey().str();
+       }
+     }
+   }
+
+   llvm::CodeGenOpt::Level level = llvm::CodeGenOpt::None;
+   if (optLevel == 1) level = llvm::CodeGenOpt::Less;
+   else if (optLevel == 2) level = llvm::CodeGenOpt::Default;
+   else if (optLevel >= 3) level = llvm::CodeGenOpt::Aggressive;
+
+   return target->createTargetMachine(triple, cpu, features,
+     llvm::TargetOptions(), llvm::Reloc::PIC_, llvm::CodeModel::Default, level);
+}
+
+/* Object files are emitted into a memory buffer first since the object
+ * writer needs a seekable stream and out is usually stdout.
+ */
+bool IRGenerator::EmitNative(llvm::raw_ostream &out, bool assembly) {
+   llvm::TargetMachine *tm = GetTargetMachine();
+   if (module == NULL || tm == NULL)
+     return false;
+
+   llvm::SmallVector<char, 0> buffer;
+   llvm::raw_svector_ostream os(buffer);
+   llvm::legacy::PassManager pm;
+   llvm::TargetMachine::CodeGenFileType kind = assembly ?
+     llvm::TargetMachine::CGFT_AssemblyFile : llvm::TargetMachine::CGFT_ObjectFile;
+   if (tm->addPassesToEmitFile(pm, os, kind))
+     return false;
+   pm.run(*module);
+   out.write(buffer.data(), buffer.size());
+   out.flush();
+   return true;
+}
+
+/* Locals are built as SSA values while emitting, but with -no-ssa (and
+ * for arrays) they live in allocas and every read is a load, so even -O1
+ * starts by promoting memory to registers (SROA, part of the function
+ * pipeline). -O2 and -O3 add the full module pipeline from
+ * PassManagerBuilder: instcombine, GVN, simplifycfg, LICM, loop unrolling,
+ * inlining and the loop and SLP vectorizers.
+ */
+void IRGenerator::Optimize(int level) {
+   if (module == NULL || level <= 0)
+     return;
+
+   llvm::PassManagerBuilder builder;
+   builder.OptLevel = level;
+   builder.SizeLevel = 0;
+   if (level > 1)
+     builder.Inliner = llvm::createFunctionInliningPass(level, 0);
+   else
+     builder.Inliner = llvm::createAlwaysInlinerPass();
+   builder.DisableUnrollLoops = (level < 2);
+   builder.LoopVectorize = (level > 1);
+   builder.SLPVectorize = (level > 1);
+
+   llvm::legacy::FunctionPassManager fpm(module);
+   llvm::legacy::PassManager mpm;
+   if (llvm::TargetMachine *tm = GetTargetMachine()) {
+     // lets the vectorizers and the unroller see the host's vector width
+     fpm.add(llvm::createTargetTransformInfoWrapperPass(tm->getTargetIRAnalysis()));
+     mpm.add(llvm::createTargetTransformInfoWrapperPass(tm->getTargetIRAnalysis()));
+   }
+   builder.populateFunctionPassManager(fpm);
+   builder.populateModulePassManager(mpm);
+
+   fpm.doInitialization();
+   for (llvm::Module::iterator f = module->begin(); f != module->end(); ++f) {
+     if (!f->isDeclaration())
+       fpm.run(*f);
+   }
+   fpm.doFinalization();
+   mpm.run(*module);
+}
+
 void IRGenerator::SetFunction(llvm::Function *func) {
    currentFunc = func;
 }
@@ -37,11 +199,60 @@ llvm::Function *IRGenerator::GetFunction() const {
 }
 
 void IRGenerator::SetBasicBlock(llvm::BasicBlock *bb) {
-   currentBB = bb;
+   builder->SetInsertPoint(bb);
 }
 
 llvm::BasicBlock *IRGenerator::GetBasicBlock() const {
-   return currentBB;
+   return builder->GetInsertBlock();
+}
+
+void IRGenerator::BranchTo(llvm::BasicBlock *dest) {
+   if (builder->GetInsertBlock()->getTerminator() == NULL)
+     builder->CreateBr(dest);
+}
+
+/* The entry block ends with the branch to the body once the formals are
+ * stored, so the allocas of locals go right before that branch.
+ */
+llvm::AllocaInst *IRGenerator::CreateEntryAlloca(llvm::Type *type, const char *name) {
+   llvm::BasicBlock &entry = currentFunc->getEntryBlock();
+   llvm::IRBuilder<> entryBuilder(*context);
+   if (llvm::Instruction *term = entry.getTerminator())
+     entryBuilder.SetInsertPoint(term);
+   else
+     entryBuilder.SetInsertPoint(&entry);
+   return entryBuilder.CreateAlloca(type, NULL, name);
+}
+
+static llvm::ConstantInt *AllocaSize(llvm::Module *module, llvm::Value *storage) {
+   llvm::AllocaInst *alloca = llvm::cast<llvm::AllocaInst>(storage);
+   uint64_t size = module->getDataLayout().getTypeAllocSize(alloca->getAllocatedType());
+   return llvm::ConstantInt::get(llvm::Type::getInt64Ty(module->getContext()), size);
+}
+
+void IRGenerator::StartLifetime(llvm::Value *storage) {
+   if (codegenLevel > 0 && llvm::isa<llvm::AllocaInst>(storage)) {
+     builder->CreateLifetimeStart(storage, AllocaSize(module, storage));
+     liveLocals.push_back(storage);
+   }
+}
+
+// the locals started after depth die here, unless the block has ended
+void IRGenerator::EndLifetimes(size_t depth) {
+   if (builder->GetInsertBlock()->getTerminator() != NULL)
+     return;
+   for (size_t i = liveLocals.size(); i > depth; i--)
+     builder->CreateLifetimeEnd(liveLocals[i-1], AllocaSize(module, liveLocals[i-1]));
+}
+
+void IRGenerator::CloseScope(size_t depth) {
+   EndLifetimes(depth);
+   liveLocals.resize(depth);
+}
+
+void IRGenerator::JumpTo(const JumpTarget &target) {
+   EndLifetimes(target.liveLocals);
+   BranchTo(target.block);
 }
 
 llvm::Type *IRGenerator::GetIntType() const {
@@ -58,48 +269,139 @@ llvm::Type *IRGenerator::GetFloatType() const {
    llvm::Type *ty = llvm::Type::getFloatTy(*context);
    return ty;
 }
-llvm::Type *IRGenerator::GetVec2Type() const {
-   llvm::Type *ty = llvm::VectorType::get(llvm::Type::getFloatTy(*context),2);
-   return ty;
+/* Booleans are i1, ints and uints i32 (only the instructions tell them
+ * apart), vectors LLVM vectors of their components and matrices arrays
+ * of their column vectors. Void, error and named types lower to void.
+ */
+void IRGenerator::BuildTypeTable() {
+   llvm::Type *voidTy = llvm::Type::getVoidTy(*context);
+   llvm::Type *boolTy = GetBoolType();
+   llvm::Type *intTy = GetIntType();
+   llvm::Type *floatTy = GetFloatType();
+
+   typeTable.assign(NumTypeTags, voidTy);
+   typeTable[TypeBool] = boolTy;
+   typeTable[TypeInt] = intTy;
+   typeTable[TypeUint] = intTy;
+   typeTable[TypeFloat] = floatTy;
+   for (int n = 2; n <= 4; n++) {
+     typeTable[TypeVec2 + n-2] = llvm::VectorType::get(floatTy, n);
+     typeTable[TypeIvec2 + n-2] = llvm::VectorType::get(intTy, n);
+     typeTable[TypeUvec2 + n-2] = llvm::VectorType::get(intTy, n);
+     typeTable[TypeBvec2 + n-2] = llvm::VectorType::get(boolTy, n);
+     typeTable[TypeMat2 + n-2] = llvm::ArrayType::get(typeTable[TypeVec2 + n-2], n);
+   }
 }
-llvm::Type *IRGenerator::GetVec3Type() const {
-   llvm::Type *ty = llvm::VectorType::get(llvm::Type::getFloatTy(*context),3);
+
+llvm::Type *IRGenerator::GetType(Type* type) {
+   Assert(!typeTable.empty());
+   if (type->GetTag() != TypeArray)
+     return typeTable[type->GetTag()];
+
+   ArrayType *array = static_cast<ArrayType*>(type);
+   std::pair<Type*,int> key(array->GetElemType(), array->GetElemCount());
+   llvm::DenseMap<std::pair<Type*,int>, llvm::Type*>::iterator it = arrayTypes.find(key);
+   if (it != arrayTypes.end())
+     return it->second;
+   llvm::Type *ty = llvm::ArrayType::get(GetType(key.first), key.second);
+   arrayTypes[key] = ty;
    return ty;
 }
-llvm::Type *IRGenerator::GetVec4Type() const {
-   llvm::Type *ty = llvm::VectorType::get(llvm::Type::getFloatTy(*context),4);
-   return ty;
+
+void IRGenerator::WriteVariable(VarDecl *var, llvm::Value *value) {
+   currentDef[VarInBlock(var, GetBasicBlock())] = value;
 }
-llvm::Type *IRGenerator::GetMat2Type() const {
-   llvm::Type *eTy = llvm::VectorType::get(llvm::Type::getFloatTy(*context),2);
-   llvm::Type *ty = llvm::ArrayType::get(eTy,2);
-   return ty;
+
+llvm::Value *IRGenerator::ReadVariable(VarDecl *var, llvm::Type *type) {
+   return ReadVariable(var, type, GetBasicBlock());
 }
-llvm::Type *IRGenerator::GetMat3Type() const {
-   llvm::Type *eTy = llvm::VectorType::get(llvm::Type::getFloatTy(*context),3);
-   llvm::Type *ty = llvm::ArrayType::get(eTy,3);
-   return ty;
+
+llvm::Value *IRGenerator::ReadVariable(VarDecl *var, llvm::Type *type, llvm::BasicBlock *bb) {
+   llvm::DenseMap<VarInBlock, llvm::WeakVH>::iterator it = currentDef.find(VarInBlock(var, bb));
+   if (it != currentDef.end())
+     return it->second;
+   return ReadVariableRecursive(var, type, bb);
 }
-llvm::Type *IRGenerator::GetMat4Type() const {
-   llvm::Type *eTy = llvm::VectorType::get(llvm::Type::getFloatTy(*context),4);
-   llvm::Type *ty = llvm::ArrayType::get(eTy,4);
-   return ty;
+
+static llvm::PHINode *CreatePhi(llvm::Type *type, VarDecl *var, llvm::BasicBlock *bb) {
+   const char *name = var->GetIdentifier()->GetName();
+   if (bb->empty())
+     return llvm::PHINode::Create(type, 2, name, bb);
+   return llvm::PHINode::Create(type, 2, name, &bb->front());
 }
-llvm::Type *IRGenerator::GetType(Type* type) const {
-   llvm::Type *ty = llvm::Type::getVoidTy(*(context));
-   if (type == Type::floatType) { ty = GetFloatType(); }
-   else if (type == Type::intType) { ty = GetIntType(); }
-   else if (type == Type::boolType) { ty = GetBoolType(); }
-   else if (type == Type::mat2Type) { ty = GetMat2Type(); }
-   else if (type == Type::mat3Type) { ty = GetMat3Type(); }
-   else if (type == Type::mat4Type) { ty = GetMat4Type(); }
-   else if (type == Type::vec2Type) { ty = GetVec2Type(); }
-   else if (type == Type::vec3Type) { ty = GetVec3Type(); }
-   else if (type == Type::vec4Type) { ty = GetVec4Type(); }
-   return ty;
+
+/* The value of var isn't defined in bb itself, so it comes from the
+ * predecessors: directly from a single one, through a phi otherwise. The
+ * phi is recorded as the value before its operands are read so loops
+ * find it instead of recursing forever. In a block that isn't sealed the
+ * phi stays incomplete until SealBlock; with no predecessors at all the
+ * variable was never assigned and is undef.
+ */
+llvm::Value *IRGenerator::ReadVariableRecursive(VarDecl *var, llvm::Type *type, llvm::BasicBlock *bb) {
+   llvm::Value *value;
+   if (!sealedBlocks.count(bb)) {
+     llvm::PHINode *phi = CreatePhi(type, var, bb);
+     incompletePhis[bb].push_back(std::make_pair(var, phi));
+     value = phi;
+   } else if (llvm::BasicBlock *pred = bb->getSinglePredecessor()) {
+     value = ReadVariable(var, type, pred);
+   } else if (llvm::pred_begin(bb) == llvm::pred_end(bb)) {
+     value = llvm::UndefValue::get(type);
+   } else {
+     llvm::PHINode *phi = CreatePhi(type, var, bb);
+     currentDef[VarInBlock(var, bb)] = phi;
+     value = AddPhiOperands(var, phi);
+   }
+   currentDef[VarInBlock(var, bb)] = value;
+   return value;
 }
 
-const char *IRGenerator::TargetLayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128";
+llvm::Value *IRGenerator::AddPhiOperands(VarDecl *var, llvm::PHINode *phi) {
+   llvm::BasicBlock *bb = phi->getParent();
+   for (llvm::pred_iterator it = llvm::pred_begin(bb); it != llvm::pred_end(bb); ++it)
+     phi->addIncoming(ReadVariable(var, phi->getType(), *it), *it);
+   return TryRemoveTrivialPhi(phi);
+}
 
-const char *IRGenerator::TargetTriple = "x86_64-redhat-linux-gnu";
+/* A phi whose operands are all one value (or the phi itself) is replaced
+ * by that value, which can make the phis using it trivial in turn.
+ */
+llvm::Value *IRGenerator::TryRemoveTrivialPhi(llvm::PHINode *phi) {
+   llvm::Value *same = NULL;
+   for (unsigned i = 0; i < phi->getNumIncomingValues(); i++) {
+     llvm::Value *op = phi->getIncomingValue(i);
+     if (op == same || op == phi)
+       continue;
+     if (same != NULL)
+       return phi;
+     same = op;
+   }
+   if (same == NULL)
+     same = llvm::UndefValue::get(phi->getType());
 
+   // weak handles, as removing one user can remove another
+   std::vector<llvm::WeakVH> users;
+   for (llvm::User *user : phi->users()) {
+     if (user != phi && llvm::isa<llvm::PHINode>(user))
+       users.push_back(user);
+   }
+   phi->replaceAllUsesWith(same);
+   phi->eraseFromParent();
+   llvm::WeakVH result(same);   // same may be one of the users
+   for (size_t i = 0; i < users.size(); i++) {
+     if (llvm::PHINode *user = llvm::dyn_cast_or_null<llvm::PHINode>(users[i]))
+       TryRemoveTrivialPhi(user);
+   }
+   return result;
+}
+
+void IRGenerator::SealBlock(llvm::BasicBlock *bb) {
+   if (!buildSSA)
+     return;
+   std::vector<std::pair<VarDecl*, llvm::PHINode*> > phis;
+   phis.swap(incompletePhis[bb]);
+   incompletePhis.erase(bb);
+   for (size_t i = 0; i < phis.size(); i++)
+     AddPhiOperands(phis[i].first, phis[i].second);
+   sealedBlocks.insert(bb);
+}
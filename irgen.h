@@ -16,8 +16,17 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/ValueHandle.h"
 #include <stack>
+#include <string>
+#include <vector>
 class Type;
+class VarDecl;
 
 class IRGenerator {
   public:
@@ -25,38 +34,135 @@ class IRGenerator {
     ~IRGenerator();
 
     llvm::Module   *GetOrCreateModule(const char *moduleID);
+    llvm::Module   *GetModule() const { return module; }
+    // Gives up ownership of the module (its context stays with us)
+    llvm::Module   *ReleaseModule();
+
+    // Builds the module in context, which is owned by the caller and
+    // must outlive the module, instead of in a context of our own. Must
+    // be called before the module is created.
+    void SetContext(llvm::LLVMContext *context);
+
+    // Selects the cpu ("native" for the host, NULL for generic) and the
+    // code generation level used for the host TargetMachine. Must be
+    // called before the module is created.
+    void SetTarget(const char *cpu, int optLevel);
+    llvm::TargetMachine *GetTargetMachine();
+
+    // Uses tm, which is owned by the caller and must outlive us, instead
+    // of creating a TargetMachine from the SetTarget() settings
+    void SetTargetMachine(llvm::TargetMachine *tm);
+
+    // A new TargetMachine for the host and the given cpu and code
+    // generation level, NULL if the host target is not registered
+    static llvm::TargetMachine *CreateTargetMachine(const char *cpu, int optLevel);
+
+    // Runs the optimization pipeline for the given level (0-3) over
+    // the module. Level 0 leaves the module untouched.
+    void Optimize(int level);
+
+    // Lowers the module to native assembly or an object file for the
+    // host and writes it to out. Returns false if that is not possible.
+    bool EmitNative(llvm::raw_ostream &out, bool assembly);
     llvm::LLVMContext *GetContext() const { return context; }
 
     // Add your helper functions here
     llvm::Function *GetFunction() const;
     void      SetFunction(llvm::Function *func);
 
+    // Every instruction is built through the builder, at the end of the
+    // current basic block. Its default folder folds instructions whose
+    // operands are all constants into constants as they are built.
+    llvm::IRBuilder<> &GetBuilder() { return *builder; }
     llvm::BasicBlock *GetBasicBlock() const;
     void        SetBasicBlock(llvm::BasicBlock *bb);
+    // Ends the current block with a branch to dest, unless a break,
+    // continue or return already ended it
+    void        BranchTo(llvm::BasicBlock *dest);
+
+    // Creates the storage of a local in the entry block of the current
+    // function, whatever block it is declared in, so the alloca runs once
+    // per call and mem2reg/SROA can promote it to a register
+    llvm::AllocaInst *CreateEntryAlloca(llvm::Type *type, const char *name);
+    // Mark where a local declared in a block comes to life and where it
+    // dies, so locals of disjoint scopes can share a stack slot. Only
+    // emitted when optimizing (-O1 and up). A scope notes LiveLocals()
+    // as it opens and calls CloseScope with it as it closes; a break,
+    // continue or return ends the locals of the scopes it leaves with
+    // EndLifetimes, so every path out of a scope ends what it started.
+    void StartLifetime(llvm::Value *storage);
+    size_t LiveLocals() const { return liveLocals.size(); }
+    void EndLifetimes(size_t depth);
+    void CloseScope(size_t depth);
+
+    // Direct SSA construction (Braun et al., "Simple and Efficient
+    // Construction of Static Single Assignment Form"). Locals placed in
+    // SSA (see VarDecl::PlaceInSSA) get no storage: assignments record the
+    // current value of the variable in the current block, reads look it up
+    // and insert phis on demand at joins. A block must be sealed once all
+    // branches to it are emitted; reads in it until then get incomplete
+    // phis that sealing fills in. On unless -no-ssa is given.
+    void SetBuildSSA(bool on) { buildSSA = on; }
+    bool BuildsSSA() const { return buildSSA; }
+    void WriteVariable(VarDecl *var, llvm::Value *value);
+    llvm::Value *ReadVariable(VarDecl *var, llvm::Type *type);
+    void SealBlock(llvm::BasicBlock *bb);
 
     llvm::Type *GetIntType() const;
     llvm::Type *GetBoolType() const;
     llvm::Type *GetFloatType() const;
-    llvm::Type *GetVec2Type() const;
-    llvm::Type *GetVec3Type() const;
-    llvm::Type *GetVec4Type() const;
-    llvm::Type *GetMat2Type() const;
-    llvm::Type *GetMat3Type() const;
-    llvm::Type *GetMat4Type() const;
-    llvm::Type *GetType(Type *t) const;
-
-    std::stack<llvm::BasicBlock*> contStck;
-    std::stack<llvm::BasicBlock*> breakStck;
+    // The LLVM type t is lowered to. Only valid once the module exists.
+    llvm::Type *GetType(Type *t);
+
+    // where continue and break go, and the live locals at that point
+    struct JumpTarget {
+      llvm::BasicBlock *block;
+      size_t liveLocals;
+      JumpTarget(llvm::BasicBlock *block, size_t liveLocals)
+        : block(block), liveLocals(liveLocals) {}
+    };
+    // Ends the lifetimes the jump leaves and branches to the target
+    void JumpTo(const JumpTarget &target);
+    std::stack<JumpTarget> contStck;
+    std::stack<JumpTarget> breakStck;
   private:
     llvm::LLVMContext *context;
+    bool               ownsContext;
     llvm::Module      *module;
 
-    // track which function or basic block is active
+    // track which function is active; the builder tracks the block
     llvm::Function    *currentFunc;
-    llvm::BasicBlock  *currentBB;
+    llvm::IRBuilder<> *builder;
+
+    // lowering of each built-in type indexed by its TypeTag, built with
+    // the module since it belongs to the context, and of the array types
+    // by element type and count
+    void BuildTypeTable();
+    std::vector<llvm::Type*> typeTable;
+    llvm::DenseMap<std::pair<Type*,int>, llvm::Type*> arrayTypes;
+
+    // state of the SSA construction: the value of each variable at the
+    // end of each block so far (a WeakVH follows the replacement of a
+    // trivial phi), the phis waiting for their block to be sealed and the
+    // sealed blocks
+    bool buildSSA;
+    typedef std::pair<VarDecl*, llvm::BasicBlock*> VarInBlock;
+    llvm::DenseMap<VarInBlock, llvm::WeakVH> currentDef;
+    llvm::DenseMap<llvm::BasicBlock*, std::vector<std::pair<VarDecl*, llvm::PHINode*> > > incompletePhis;
+    llvm::SmallPtrSet<llvm::BasicBlock*, 32> sealedBlocks;
+    llvm::Value *ReadVariable(VarDecl *var, llvm::Type *type, llvm::BasicBlock *bb);
+    llvm::Value *ReadVariableRecursive(VarDecl *var, llvm::Type *type, llvm::BasicBlock *bb);
+    llvm::Value *AddPhiOperands(VarDecl *var, llvm::PHINode *phi);
+    llvm::Value *TryRemoveTrivialPhi(llvm::PHINode *phi);
+
+    // storage of the locals whose lifetime has started, innermost last
+    std::vector<llvm::Value*> liveLocals;
 
-    static const char *TargetTriple;
-    static const char *TargetLayout;
+    // the module's triple and data layout come from the host machine
+    llvm::TargetMachine *targetMachine;
+    bool               ownsTargetMachine;
+    std::string        targetCPU;
+    int                codegenLevel;
 };
 
 #endif
@@ -0,0 +1,248 @@
+/* jit.cc - in-process execution of the generated module
+ *
+ * Reads a .dat file, binds its gin: lines to the initializers of the
+ * module's globals and its param: lines to the arguments of a small
+ * wrapper function that calls the requested function and stores the
+ * result. The module is then compiled with MCJIT and the wrapper is
+ * called directly, so no bitcode is written and no interpreter process
+ * is started.
+ */
+
+#include "jit.h"
+#include "errors.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetSelect.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char *WrapperName = "__glc_run";
+static const char *ResultName  = "__glc_result";
+
+// One gin: or param: line of the .dat file. The glc type name is kept
+// only for error messages, the values are converted using the llvm type
+// of the global or formal they are bound to.
+struct Binding {
+    string name;              // empty for param: lines
+    string typeName;
+    vector<string> values;
+};
+
+static string Trim(const string &s) {
+    size_t first = s.find_first_not_of(" \t\r\n");
+    if (first == string::npos) return "";
+    size_t last = s.find_last_not_of(" \t\r\n");
+    return s.substr(first, last - first + 1);
+}
+
+static void Split(const string &s, vector<string> &fields) {
+    size_t start = 0;
+    for (;;) {
+      size_t comma = s.find(',', start);
+      fields.push_back(Trim(s.substr(start, comma - start)));
+      if (comma == string::npos) break;
+      start = comma + 1;
+    }
+}
+
+static bool ReadDatFile(const char *datFile, string &funct,
+                        vector<Binding> &gins, vector<Binding> &params) {
+    FILE *fp = fopen(datFile, "r");
+    if (fp == NULL) {
+      ReportError::Formatted(NULL, "Cannot open data file '%s'", datFile);
+      return false;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+      string text(line);
+      size_t colon = text.find(':');
+      if (colon == string::npos) continue;
+      string key = Trim(text.substr(0, colon));
+      vector<string> fields;
+      Split(text.substr(colon + 1), fields);
+
+      if (key == "funct") {
+        funct = fields[0];
+      } else if (key == "gin" && fields.size() >= 3) {
+        Binding b;
+        b.name = fields[0];
+        b.typeName = fields[1];
+        b.values.assign(fields.begin() + 2, fields.end());
+        gins.push_back(b);
+      } else if (key == "param" && fields.size() >= 2) {
+        Binding b;
+        b.typeName = fields[0];
+        b.values.assign(fields.begin() + 1, fields.end());
+        params.push_back(b);
+      }
+    }
+    fclose(fp);
+    if (funct.empty()) {
+      ReportError::Formatted(NULL, "No funct: line in data file '%s'", datFile);
+      return false;
+    }
+    return true;
+}
+
+/* Builds a constant of type ty from values, starting at values[next].
+ * Vectors and matrices consume one value per scalar component. Returns
+ * NULL if there are not enough values or ty cannot be initialized.
+ */
+static llvm::Constant *MakeConstant(llvm::Type *ty, const vector<string> &values,
+                                    unsigned &next) {
+    if (ty->isIntegerTy() || ty->isFloatingPointTy()) {
+      if (next >= values.size()) return NULL;
+      const string &v = values[next++];
+      if (ty->isFloatingPointTy())
+        return llvm::ConstantFP::get(ty, strtod(v.c_str(), NULL));
+      long val = (v == "true") ? 1 : (v == "false") ? 0 : strtol(v.c_str(), NULL, 0);
+      return llvm::ConstantInt::get(ty, val, true);
+    }
+    if (llvm::VectorType *vt = llvm::dyn_cast<llvm::VectorType>(ty)) {
+      vector<llvm::Constant*> elems;
+      for (unsigned i = 0; i < vt->getNumElements(); i++) {
+        llvm::Constant *c = MakeConstant(vt->getElementType(), values, next);
+        if (c == NULL) return NULL;
+        elems.push_back(c);
+      }
+      return llvm::ConstantVector::get(elems);
+    }
+    if (llvm::ArrayType *at = llvm::dyn_cast<llvm::ArrayType>(ty)) {
+      vector<llvm::Constant*> elems;
+      for (unsigned i = 0; i < at->getNumElements(); i++) {
+        llvm::Constant *c = MakeConstant(at->getElementType(), values, next);
+        if (c == NULL) return NULL;
+        elems.push_back(c);
+      }
+      return llvm::ConstantArray::get(at, elems);
+    }
+    return NULL;
+}
+
+/* Prints the value of type ty stored at addr the way gli does: integers
+ * (and bools) sign-extended, floats in %e notation, aggregates one
+ * component after the other.
+ */
+static void PrintValue(llvm::Type *ty, const char *addr, const llvm::DataLayout &dl) {
+    if (ty->isIntegerTy()) {
+      unsigned bits = ty->getIntegerBitWidth();
+      uint64_t raw = 0;
+      memcpy(&raw, addr, (bits + 7) / 8);
+      int64_t val = (int64_t)(raw << (64 - bits)) >> (64 - bits);
+      printf("%lld", (long long)val);
+    } else if (ty->isFloatTy()) {
+      float f;
+      memcpy(&f, addr, sizeof(f));
+      printf("%e", f);
+    } else if (ty->isDoubleTy()) {
+      double d;
+      memcpy(&d, addr, sizeof(d));
+      printf("%e", d);
+    } else if (ty->isVectorTy() || ty->isArrayTy()) {
+      llvm::Type *elemTy = ty->getSequentialElementType();
+      unsigned count = ty->isVectorTy() ? ty->getVectorNumElements()
+                                        : ty->getArrayNumElements();
+      uint64_t stride = ty->isVectorTy() ? dl.getTypeStoreSize(elemTy)
+                                         : dl.getTypeAllocSize(elemTy);
+      for (unsigned i = 0; i < count; i++) {
+        if (i > 0) printf(" ");
+        PrintValue(elemTy, addr + i * stride, dl);
+      }
+    }
+}
+
+int RunModule(llvm::Module *mod, const char *datFile) {
+    string funct;
+    vector<Binding> gins, params;
+    if (!ReadDatFile(datFile, funct, gins, params))
+      return 1;
+
+    llvm::Function *f = mod->getFunction(funct);
+    if (f == NULL || f->isDeclaration()) {
+      ReportError::Formatted(NULL, "No definition for function '%s'", funct.c_str());
+      return 1;
+    }
+    llvm::FunctionType *fnTy = f->getFunctionType();
+    if (fnTy->getNumParams() != params.size()) {
+      ReportError::Formatted(NULL, "Function '%s' expects %d arguments, %d given",
+                             funct.c_str(), fnTy->getNumParams(), (int)params.size());
+      return 1;
+    }
+
+    // gin: lines become the initializers of the globals
+    for (unsigned i = 0; i < gins.size(); i++) {
+      llvm::GlobalVariable *gv = mod->getNamedGlobal(gins[i].name);
+      unsigned next = 0;
+      llvm::Constant *c = gv ? MakeConstant(gv->getValueType(), gins[i].values, next) : NULL;
+      if (c == NULL) {
+        ReportError::Formatted(NULL, "Cannot bind global '%s' of type %s",
+                               gins[i].name.c_str(), gins[i].typeName.c_str());
+        return 1;
+      }
+      gv->setInitializer(c);
+    }
+
+    // param: lines become the constant arguments of a call in the wrapper
+    llvm::LLVMContext &context = mod->getContext();
+    vector<llvm::Value*> args;
+    for (unsigned i = 0; i < params.size(); i++) {
+      unsigned next = 0;
+      llvm::Constant *c = MakeConstant(fnTy->getParamType(i), params[i].values, next);
+      if (c == NULL) {
+        ReportError::Formatted(NULL, "Cannot bind argument %d of type %s",
+                               i + 1, params[i].typeName.c_str());
+        return 1;
+      }
+      args.push_back(c);
+    }
+
+    llvm::FunctionType *wrapTy = llvm::FunctionType::get(llvm::Type::getVoidTy(context), false);
+    llvm::Function *wrapper = llvm::Function::Create(wrapTy,
+      llvm::GlobalValue::ExternalLinkage, WrapperName, mod);
+    llvm::BasicBlock *bb = llvm::BasicBlock::Create(context, "entry", wrapper);
+    llvm::Value *ret = llvm::CallInst::Create(f, args, "", bb);
+    llvm::Type *retTy = fnTy->getReturnType();
+    if (!retTy->isVoidTy()) {
+      llvm::GlobalVariable *result = new llvm::GlobalVariable(*mod, retTy, false,
+        llvm::GlobalValue::ExternalLinkage, llvm::Constant::getNullValue(retTy), ResultName);
+      new llvm::StoreInst(ret, result, bb);
+    }
+    llvm::ReturnInst::Create(context, bb);
+
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    string err;
+    llvm::ExecutionEngine *ee = llvm::EngineBuilder(std::unique_ptr<llvm::Module>(mod))
+      .setErrorStr(&err)
+      .setEngineKind(llvm::EngineKind::JIT)
+      .setMCPU(llvm::sys::getHostCPUName())
+      .create();
+    if (ee == NULL) {
+      ReportError::Formatted(NULL, "Cannot create JIT: %s", err.c_str());
+      return 1;
+    }
+    ee->finalizeObject();
+
+    void (*run)() = (void (*)())ee->getFunctionAddress(WrapperName);
+    run();
+
+    if (!retTy->isVoidTy()) {
+      const char *addr = (const char *)ee->getGlobalValueAddress(ResultName);
+      printf("Result: ");
+      PrintValue(retTy, addr, ee->getDataLayout());
+      printf("\n");
+    }
+    fflush(stdout);
+    delete ee;
+    return 0;
+}
@@ -0,0 +1,32 @@
+/**
+ * File: jit.h
+ * -----------
+ *  This file declares the in-process execution mode of the compiler
+ *  (glc --run). Instead of writing bitcode for an external interpreter,
+ *  the module built by Program::Emit is JIT-compiled with MCJIT and the
+ *  function named in a test .dat file is called directly.
+ *
+ *  The .dat format is the one used by the tests directory:
+ *
+ *      funct: <name>                  function to call
+ *      gin: <name>, <type>, <v>...    initial value of a global variable
+ *      param: <type>, <v>...          next actual argument of the call
+ *
+ *  The value returned by the function is printed as "Result: <value>".
+ */
+
+#ifndef _H_jit
+#define _H_jit
+
+#include "llvm/IR/Module.h"
+
+/* Function: RunModule()
+ * ---------------------
+ * Binds the globals and arguments described by the .dat file to mod, runs
+ * the requested function and prints its result to stdout. Takes ownership
+ * of mod. Returns 0 on success, non-zero if the .dat file could not be
+ * read or does not match the module.
+ */
+int RunModule(llvm::Module *mod, const char *datFile);
+
+#endif
@@ -4,9 +4,13 @@
  * Simple list class for storing a linear collection of elements. It
  * supports operations similar in name to the CS107 CVector -- nth, insert,
  * append, remove, etc.  This class is nothing more than a very thin
- * cover of a STL deque, with some added range-checking. Given not everyone
- * is familiar with the C++ templates, this class provides a more familiar
- * interface.
+ * cover of an llvm::SmallVector, with some added range-checking in debug
+ * builds. Given not everyone is familiar with the C++ templates, this
+ * class provides a more familiar interface.
+ *
+ * The elements are stored contiguously, and the first four are stored
+ * inside the List itself, which is all most blocks, parameter and
+ * argument lists of a shader ever hold.
  *
  * It can handle elements of any type, the typename for a List includes the
  * element type in angle brackets, e.g.  to store elements of type double,
@@ -23,26 +27,53 @@
  *       }
  *       return sum;
  *    }
+ *
+ * or, with the iterators, for (int val : *list) sum += val;
  */
 
 #ifndef _H_list
 #define _H_list
 
-#include <deque>
+#include <new>
+#include "llvm/ADT/SmallVector.h"
 #include "utility.h"  // for Assert()
+#include "arena.h"
 using namespace std;
 
 class Node;
 
+// Range checks on element access, compiled out with NDEBUG
+#ifdef NDEBUG
+#define ListAssert(expr) ((void)0)
+#else
+#define ListAssert(expr) Assert(expr)
+#endif
+
 template<class Element> class List {
 
  private:
-    deque<Element> elems;
+    typedef llvm::SmallVector<Element, 4> Storage;
+    Storage elems;
 
  public:
+    typedef typename Storage::iterator iterator;
+    typedef typename Storage::const_iterator const_iterator;
+
            // Create a new empty list
     List() {}
 
+           // Lists are allocated in the arena of the current compilation
+           // like the nodes holding them (see arena.h), and are destroyed
+           // when it is released
+    static void *operator new(size_t size)
+        { Arena *arena = CurrentArena();
+          if (arena == NULL) return ::operator new(size);
+          void *p = arena->Allocate(size, alignof(List));
+          arena->CountList();
+          arena->AddCleanup(Destroy, p);
+          return p; }
+    static void operator delete(void *p) {}
+
            // Returns count of elements currently in list
     int NumElements() const
 	{ return elems.size(); }
@@ -50,13 +81,13 @@ template<class Element> class List {
           // Returns element at index in list. Indexing is 0-based.
           // Raises an assert if index is out of range.
     Element Nth(int index) const
-	{ Assert(index >= 0 && index < NumElements());
+	{ ListAssert(index >= 0 && index < NumElements());
 	  return elems[index]; }
 
           // Inserts element at index, shuffling over others
           // Raises assert if index out of range
     void InsertAt(const Element &elem, int index)
-	{ Assert(index >= 0 && index <= NumElements());
+	{ ListAssert(index >= 0 && index <= NumElements());
 	  elems.insert(elems.begin() + index, elem); }
 
           // Adds element to list end
@@ -66,23 +97,39 @@ template<class Element> class List {
          // Removes element at index, shuffling down others
          // Raises assert if index out of range
     void RemoveAt(int index)
-	{ Assert(index >= 0 && index < NumElements());
+	{ ListAssert(index >= 0 && index < NumElements());
 	  elems.erase(elems.begin() + index); }
-          
+
+         // Releases the capacity left over from growing the list. Called
+         // by the nodes that take over a list once the parser is done
+         // appending to it.
+    void ShrinkToFit()
+        { if (elems.size() <= 4 || elems.capacity() == elems.size()) return;
+          Storage fitted;
+          fitted.reserve(elems.size());
+          fitted.append(elems.begin(), elems.end());
+          elems.swap(fitted); }
+
+    iterator begin()             { return elems.begin(); }
+    iterator end()               { return elems.end(); }
+    const_iterator begin() const { return elems.begin(); }
+    const_iterator end() const   { return elems.end(); }
+
        // These are some specific methods useful for lists of ast nodes
        // They will only work on lists of elements that respond to the
        // messages, but since C++ only instantiates the template if you use
        // you can still have Lists of ints, chars*, as long as you 
        // don't try to SetParentAll on that list.
     void SetParentAll(Node *p)
-        { for (int i = 0; i < NumElements(); i++)
-             Nth(i)->SetParent(p); }
+        { for (Element e : elems)
+             e->SetParent(p); }
     void PrintAll(int indentLevel, const char *label = NULL)
-        { for (int i = 0; i < NumElements(); i++)
-             Nth(i)->Print(indentLevel, label); }
-             
+        { for (Element e : elems)
+             e->Print(indentLevel, label); }
 
+ private:
+    static void Destroy(void *p)
+        { static_cast<List *>(p)->~List(); }
 };
 
 #endif
-
@@ -2,13 +2,29 @@
  * ----------------
  * This file just contains features relative to the location structure
  * used to record the lexical position of a token or symbol.  This file
- * establishes the cmoon definition for the yyltype structure, the global
- * variable yylloc, and a utility function to join locations you might
- * find handy at times.
+ * establishes the cmoon definition for the yyltype structure and a
+ * utility function to join locations you might find handy at times. The
+ * parser is pure, so there is no global yylloc: the scanner fills in the
+ * location it is handed by yyparse().
+ *
+ * A location is just the byte offsets of its first and last character
+ * in the source, which every Node keeps inline. The line and column are
+ * decoded from the offset only when they are printed, from the line
+ * starts the scanner records (see CompilationContext::LineOf).
  */
 
 #ifndef YYLTYPE
 
+#include <stdint.h>
+
+/* Typedef: SourceLoc
+ * ------------------
+ * Byte offset of a character in the source being compiled.
+ */
+typedef uint32_t SourceLoc;
+
+const SourceLoc NoLoc = 0xffffffff;   // for nodes without a location
+
 /* Typedef: yyltype
  * ----------------
  * Defines the struct type that is used by the scanner to store
@@ -16,21 +32,23 @@
  */
 typedef struct yyltype
 {
-    int timestamp;                 // you can ignore this field
-    int first_line, first_column;
-    int last_line, last_column;      
-    char *text;                    // you can also ignore this field
+    SourceLoc begin, end;   // first and last character, inclusive
 } yyltype;
 
 #define YYLTYPE yyltype
 
-
-/* Global variable: yylloc
- * ------------------------
- * The global variable holding the position information about the
- * lexeme just scanned.
+/* The location of a rule spans its first to its last symbol; an empty
+ * rule is placed at the end of the symbol before it.
  */
-extern struct yyltype yylloc;
+#define YYLLOC_DEFAULT(Current, Rhs, N)                             \
+    do {                                                            \
+      if (N) {                                                      \
+        (Current).begin = YYRHSLOC(Rhs, 1).begin;                   \
+        (Current).end = YYRHSLOC(Rhs, N).end;                       \
+      } else {                                                      \
+        (Current).begin = (Current).end = YYRHSLOC(Rhs, 0).end;     \
+      }                                                             \
+    } while (0)
 
 
 /* Function: Join
@@ -41,10 +59,8 @@ extern struct yyltype yylloc;
 inline yyltype Join(yyltype first, yyltype last)
 {
   yyltype combined;
-  combined.first_column = first.first_column;
-  combined.first_line = first.first_line;
-  combined.last_column = last.last_column;
-  combined.last_line = last.last_line;
+  combined.begin = first.begin;
+  combined.end = last.end;
   return combined;
 }
 
@@ -56,4 +72,3 @@ inline yyltype Join(yyltype *firstPtr, yyltype *lastPtr)
 
 
 #endif
-
@@ -1,7 +1,8 @@
 /* File: main.cc
  * -------------
  * This file defines the main() routine for the program and not much else.
- * You should not need to modify this file.
+ * It drives the phases of the compiler and decides what to do with the
+ * module built by Program::Emit: write it out as bitcode or run it.
  */
  
 #include <string.h>
@@ -9,22 +10,93 @@
 #include "utility.h"
 #include "errors.h"
 #include "parser.h"
+#include "options.h"
+#include "irgen.h"
+#include "context.h"
+#include "driver.h"
+#include "jit.h"
+#include "server.h"
+#include "timing.h"
+#include "trace.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <new>
+
+
+/* The global allocation operators are replaced to count the allocations
+ * made on each thread for -d time-report (see timing.h). They live here
+ * rather than in the library so programs embedding libglc keep their own.
+ */
+void *operator new(size_t size) {
+    numAllocations++;
+    allocatedBytes += size;
+    // built without exceptions: retry while a new_handler can free
+    // memory, otherwise give up
+    for (;;) {
+        void *p = malloc(size ? size : 1);
+        if (p != NULL)
+            return p;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == NULL) {
+            fprintf(stderr, "glc: out of memory\n");
+            abort();
+        }
+        handler();
+    }
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept {
+    free(p);
+}
 
 
 /* Function: main()
  * ----------------
  * Entry point to the entire program.  We parse the command line and turn
  * on any debugging flags requested by the user when invoking the program.
- * InitScanner() is used to set up the scanner.
- * InitParser() is used to set up the parser. The call to yyparse() will
- * attempt to parse a complete program from the input. 
+ * With --serve glc runs as a compile server (see server.h). If source
+ * files are named on the command line they are compiled by
+ * CompileBatch() (see driver.h). Otherwise the program is read from stdin:
+ * InitParser() is used to set up the parser, and a CompilationContext
+ * (see context.h) scans and parses a complete program from the input,
+ * emits it into a module and runs the optimization pipeline selected by
+ * -O<n>. With --run the module is executed in-process using the .dat
+ * file given, otherwise its bitcode (or with -emit=asm|obj, native code
+ * for the host) is written to standard output by CompileSource(), which
+ * also consults the cache given with --cache-dir. A trace requested with
+ * --trace-out is written when the program exits.
  */
 int main(int argc, char *argv[])
 {
     ParseCommandLine(argc, argv);
-    InitScanner();
     InitParser();
-    yyparse();
-    return (ReportError::NumErrors() == 0? 0 : -1);
-}
+    if (compilerOptions.traceOut) {
+        StartTrace(compilerOptions.traceOut);
+        SetTraceThreadName("main");
+        atexit(FinishTrace);
+    }
+    if (compilerOptions.servePath)
+        return Serve(compilerOptions.servePath, compilerOptions);
+    if (!compilerOptions.inputs.empty())
+        return (CompileBatch(compilerOptions) == 0 ? 0 : -1);
 
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > input =
+        llvm::MemoryBuffer::getSTDIN();
+    if (!input) {
+        ReportError::Formatted(NULL, "Cannot read standard input");
+        return -1;
+    }
+    llvm::StringRef source = (*input)->getBuffer();
+    if (!compilerOptions.runData)
+        return CompileSource(source, compilerOptions, llvm::outs()) ? 0 : -1;
+
+    CompilationContext ctx(compilerOptions);
+    if (!ctx.Compile(source.data(), source.size()))
+        return -1;
+    PhaseTimer timer(ctx.GetTimeReport(), "run");
+    return RunModule(ctx.GetIRGenerator()->ReleaseModule(), compilerOptions.runData);
+}
@@ -0,0 +1,49 @@
+/* File: options.h
+ * ---------------
+ * This file defines the set of options that control what the compiler
+ * does with the module once it has been built. The options are filled in
+ * from the command line by ParseCommandLine() (see utility.h) and are
+ * consulted by the driver in main.cc.
+ */
+
+#ifndef _H_options
+#define _H_options
+
+#include <stdlib.h>   // for NULL
+#include <stdint.h>
+#include <vector>
+
+typedef enum {
+      EmitBitcode,
+      EmitAssembly,
+      EmitObject
+} emitT;
+
+struct Options
+{
+    const char *runData;  // --run <file.dat>: JIT and execute instead of
+                          // writing bitcode, NULL if not requested
+    int optLevel;         // -O0 .. -O3: optimization pipeline to run
+    emitT emit;           // -emit=bc|asm|obj: what is written to stdout
+    const char *cpu;      // -mcpu=<name>, "native" for the host cpu
+    int jobs;             // -j N: number of workers compiling inputs,
+                          // 0 if not given
+    std::vector<const char*> inputs;  // source files, empty to read stdin
+    const char *cacheDir; // --cache-dir=<dir>: reuse output of earlier
+                          // compilations (see cache.h), NULL for none
+    uint64_t cacheSize;   // --cache-size=<MB>: bound of the cache in bytes
+    const char *servePath;  // --serve <socket>: run as a compile server
+                            // (see server.h), NULL if not requested
+    const char *traceOut; // --trace-out=<file>: write a Chrome trace of
+                          // the compilation (see trace.h), NULL for none
+    bool buildSSA;        // cleared by -no-ssa: keep locals in allocas
+                          // instead of building SSA form (see irgen.h)
+
+    Options() : runData(NULL), optLevel(0), emit(EmitBitcode), cpu(NULL),
+                jobs(0), cacheDir(NULL), cacheSize(256 << 20),
+                servePath(NULL), traceOut(NULL), buildSSA(true) {}
+};
+
+extern Options compilerOptions;
+
+#endif
@@ -18,6 +18,8 @@
 #include "ast_expr.h"
 #include "ast_stmt.h"
 
+class CompilationContext;       // the parse-param of yyparse()
+
  
 // Next, we want to get the exported defines for the token codes and
 // typedef for YYSTYPE and exported global variable yylval.  These
@@ -32,7 +34,8 @@
 #include "y.tab.h"              
 #endif
 
-int yyparse();              // Defined in the generated y.tab.c file
+// int yyparse(CompilationContext *ctx, void *scanner) is declared in
+// y.tab.h; the tree it builds is stored in ctx (see context.h)
 void InitParser();          // Defined in parser.y
 
 #endif
@@ -19,11 +19,27 @@
 #include "scanner.h" // for yylex
 #include "parser.h"
 #include "errors.h"
-
-void yyerror(const char *msg); // standard error-handling routine
+#include "context.h"
 
 %}
 
+/* Reentrancy
+ * ----------
+ * The parser is pure: yylval and yylloc are locals of yyparse() and the
+ * scanner handle is passed to every yylex() call. The tree is handed to
+ * the CompilationContext, so no state is kept between parses and two
+ * threads can parse at the same time with their own contexts.
+ */
+%define api.pure full
+%locations
+%parse-param {CompilationContext *ctx} {void *scanner}
+%lex-param {void *scanner}
+
+%code {
+int yylex(YYSTYPE *yylval, YYLTYPE *yylloc, void *scanner);
+void yyerror(YYLTYPE *loc, CompilationContext *ctx, void *scanner, const char *msg);
+}
+
 /* The section before the first %% is the Definitions section of the yacc
  * input file. Here is where you declare tokens and types, add precedence
  * and associativity options, and so on.
@@ -42,7 +58,8 @@ void yyerror(const char *msg); // standard error-handling routine
     int integerConstant;
     bool boolConstant;
     double floatConstant;
-    char identifier[MaxIdentLen+1]; // +1 for terminating null
+    Atom identifier;                // interned by the scanner
+    OpKind opKind;
     Decl *decl;
     FnDecl *funcDecl;
     List<Decl*> *declList;
@@ -75,12 +92,12 @@ void yyerror(const char *msg); // standard error-handling routine
 %token   T_LeftParen T_RightParen T_LeftBracket T_RightBracket T_LeftBrace T_RightBrace
 %token   T_Dot T_Comma T_Colon T_Semicolon T_Question
 
-%token   <identifier> T_LessEqual T_GreaterEqual T_EQ T_NE
-%token   <identifier> T_And T_Or 
-%token   <identifier> T_Plus T_Star
-%token   <identifier> T_MulAssign T_DivAssign T_AddAssign T_SubAssign T_Equal
-%token   <identifier> T_LeftAngle T_RightAngle T_Dash T_Slash
-%token   <identifier> T_Inc T_Dec 
+%token   <opKind> T_LessEqual T_GreaterEqual T_EQ T_NE
+%token   <opKind> T_And T_Or 
+%token   <opKind> T_Plus T_Star
+%token   <opKind> T_MulAssign T_DivAssign T_AddAssign T_SubAssign T_Equal
+%token   <opKind> T_LeftAngle T_RightAngle T_Dash T_Slash
+%token   <opKind> T_Inc T_Dec 
 %token   <identifier> T_Identifier
 %token   <integerConstant> T_IntConstant
 %token   <floatConstant> T_FloatConstant
@@ -138,13 +155,14 @@ Program   :    DeclList            {
                                        * yacc to set up yylloc. You can remove 
                                        * it once you have other uses of @n*/
                                       Program *program = new Program($1);
-                                      // if no errors, advance to next phase
-                                      if (ReportError::NumErrors() == 0) {
+                                      // if no errors, hand the tree to the
+                                      // driver for the next phase
+                                      if (ctx->NumErrors() == 0) {
                                           if ( IsDebugOn("dumpAST") ) {
                                             program->Print(0);
                                           }
-                                          program->Emit();
                                       }
+                                      ctx->SetProgram(program);
                                     }
           ;
 
@@ -178,13 +196,13 @@ Declaration : FuncDecl T_Semicolon   { $$ = $1; }
 
 FuncDecl  : TypeDecl T_Identifier T_LeftParen T_RightParen 
                          {
-                            Identifier *id = new Identifier(yylloc, (const char *)$2); 
+                            Identifier *id = new Identifier(yylloc, $2); 
                             List<VarDecl *> *formals = new List<VarDecl *>;
                             $$ = new FnDecl(id, $1, formals);
                          }
           | TypeDecl T_Identifier T_LeftParen ParameterList T_RightParen 
                          {
-                            Identifier *id = new Identifier(yylloc, (const char *)$2); 
+                            Identifier *id = new Identifier(yylloc, $2); 
                             $$ = new FnDecl(id, $1, $4);
                          }
           ;
@@ -195,28 +213,28 @@ ParameterList : SingleDecl { ($$ = new List<VarDecl *>)->Append($1);  }
 
 SingleDecl    : TypeDecl T_Identifier
                          {
-                            Identifier *id = new Identifier(yylloc, (const char *)$2); 
+                            Identifier *id = new Identifier(yylloc, $2); 
                             $$ = new VarDecl(id, $1);
                          }
               | TypeQualify TypeDecl T_Identifier
                          {
-                            Identifier *id = new Identifier(yylloc, (const char *)$3); 
+                            Identifier *id = new Identifier(yylloc, $3); 
                             $$ = new VarDecl(id, $2, $1);
                          }
               | TypeDecl T_Identifier T_Equal Initializer
                          {
                             // incomplete: drop the initializer here
-                            Identifier *id = new Identifier(yylloc, (const char *)$2); 
+                            Identifier *id = new Identifier(yylloc, $2); 
                             $$ = new VarDecl(id, $1, $4);
                          }
               | TypeQualify TypeDecl T_Identifier T_Equal Initializer
                          {
-                            Identifier *id = new Identifier(yylloc, (const char *)$3); 
+                            Identifier *id = new Identifier(yylloc, $3); 
                             $$ = new VarDecl(id, $2, $1, $5);
                          }
               | TypeDecl T_Identifier T_LeftBracket T_IntConstant T_RightBracket 
                          { 
-                            Identifier *id = new Identifier(@2, (const char *)$2);
+                            Identifier *id = new Identifier(@2, $2);
                             $$ = new VarDecl(id, new ArrayType(@1, $1, $4));
                          }
               | TypeQualify TypeDecl T_Identifier T_LeftBracket T_IntConstant T_RightBracket 
@@ -246,6 +264,16 @@ TypeDecl       : T_Int                   { $$ = Type::intType;    }
                | T_Mat2                  { $$ = Type::mat2Type;   }
                | T_Mat3                  { $$ = Type::mat3Type;   }
                | T_Mat4                  { $$ = Type::mat4Type;   }
+               | T_Uint                  { $$ = Type::uintType;   }
+               | T_Ivec2                 { $$ = Type::ivec2Type;  }
+               | T_Ivec3                 { $$ = Type::ivec3Type;  }
+               | T_Ivec4                 { $$ = Type::ivec4Type;  }
+               | T_Uvec2                 { $$ = Type::uvec2Type;  }
+               | T_Uvec3                 { $$ = Type::uvec3Type;  }
+               | T_Uvec4                 { $$ = Type::uvec4Type;  }
+               | T_Bvec2                 { $$ = Type::bvec2Type;  }
+               | T_Bvec3                 { $$ = Type::bvec3Type;  }
+               | T_Bvec4                 { $$ = Type::bvec4Type;  }
                ;
 
 CompoundStatement : T_LeftBrace T_RightBrace               { $$ = new StmtBlock(new List<VarDecl*>, new List<Stmt *>); }
@@ -308,7 +336,7 @@ ForStmt            : T_For T_LeftParen Expression T_Semicolon Expression T_Semic
                                  }
                    ;
 
-PrimaryExpr        : T_Identifier    { Identifier *id = new Identifier(yylloc, (const char*)$1);
+PrimaryExpr        : T_Identifier    { Identifier *id = new Identifier(yylloc, $1);
                                        $$ = new VarExpr(yyloc, id);
                                      }
                    | T_IntConstant   { $$ = new IntConstant(yylloc, $1); }
@@ -342,17 +370,17 @@ PostfixExpr        : PrimaryExpr     { $$ = $1; }
                                        }
                    | PostfixExpr T_Inc 
                                        {
-                                          Operator *op = new Operator(yylloc, (const char *)$2);
+                                          Operator *op = new Operator(yylloc, $2);
                                           $$ = new PostfixExpr($1, op);
                                        }
                    | PostfixExpr T_Dec 
                                        {
-                                          Operator *op = new Operator(yylloc, (const char *)$2);
+                                          Operator *op = new Operator(yylloc, $2);
                                           $$ = new PostfixExpr($1, op);
                                        }
                    | PostfixExpr T_Dot T_FieldSelection
                                        {
-                                          Identifier *id = new Identifier(yylloc, (const char *)$3);
+                                          Identifier *id = new Identifier(yylloc, $3);
                                           $$ = new FieldAccess($1, id);
                                        }
                    ;
@@ -433,12 +461,12 @@ EqualityExpr       : RelationExpr       { $$ = $1; }
                    | EqualityExpr T_EQ RelationExpr 
                            {
                              Operator *op = new Operator(yylloc, $2);
-                             $$ = new ArithmeticExpr($1, op, $3);
+                             $$ = new EqualityExpr($1, op, $3);
                            }
                    | EqualityExpr T_NE RelationExpr 
                            {
                              Operator *op = new Operator(yylloc, $2);
-                             $$ = new ArithmeticExpr($1, op, $3);
+                             $$ = new EqualityExpr($1, op, $3);
                            }
                    ;
 
@@ -446,7 +474,7 @@ LogicAndExpr       : EqualityExpr       { $$ = $1; }
                    | LogicAndExpr T_And EqualityExpr
                            {
                              Operator *op = new Operator(yylloc, $2);
-                             $$ = new ArithmeticExpr($1, op, $3);
+                             $$ = new LogicalExpr($1, op, $3);
                            }
                    ;
 
@@ -454,7 +482,7 @@ LogicOrExpr        : LogicAndExpr       { $$ = $1; }
                    | LogicOrExpr T_Or LogicAndExpr
                            {
                              Operator *op = new Operator(yylloc, $2);
-                             $$ = new ArithmeticExpr($1, op, $3);
+                             $$ = new LogicalExpr($1, op, $3);
                            }
                    ;
 
@@ -470,10 +498,10 @@ Expression         : LogicOrExpr       { $$ = $1; }
                    ;
 
 AssignOp           : T_Equal         { $$ = new Operator(yylloc, $1);   }
-                   | T_AddAssign     { $$ = new Operator(yylloc, "+=");  }
-                   | T_SubAssign     { $$ = new Operator(yylloc, "-=");  }
-                   | T_MulAssign     { $$ = new Operator(yylloc, "*=");  }
-                   | T_DivAssign     { $$ = new Operator(yylloc, "/=");  }
+                   | T_AddAssign     { $$ = new Operator(yylloc, $1);   }
+                   | T_SubAssign     { $$ = new Operator(yylloc, $1);   }
+                   | T_MulAssign     { $$ = new Operator(yylloc, $1);   }
+                   | T_DivAssign     { $$ = new Operator(yylloc, $1);   }
                    ;
 
 %%
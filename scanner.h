@@ -12,12 +12,13 @@
 
 #define MaxIdentLen 31    // Maximum length for identifiers
 
-extern char *yytext;      // Text of lexeme just scanned
+class CompilationContext;
 
+// The scanner is reentrant, yylex() takes the handle returned by
+// InitScanner() (see the %lex-param in parser.y)
 
-int yylex();              // Defined in the generated lex.yy.c file
-
-void InitScanner();                 // Defined in scanner.l user subroutines
-const char *GetLineNumbered(int n); // ditto
+void *InitScanner(CompilationContext *ctx, FILE *in); // Defined in scanner.l
+void *InitScanner(CompilationContext *ctx, const char *text, int len); // ditto
+void FreeScanner(void *scanner);                       // ditto
  
 #endif
@@ -0,0 +1,188 @@
+/* File: server.cc
+ * ---------------
+ * Implementation of the compile server (see server.h for the protocol).
+ */
+
+#include "server.h"
+#include "driver.h"
+#include "context.h"
+#include "errors.h"
+#include "utility.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// compiled by each worker at startup so its first request does not pay
+// for creating the target machine and the built-in types
+static const char *WarmupSource = "int warmup(int x) { return x + 1; }\n";
+
+// bounds on a request, so a client can neither hold a worker forever nor
+// make the server buffer an unbounded amount of source
+static const size_t MaxRequestBytes = 16 << 20;
+static const int RequestTimeout = 30;
+
+static char socketPath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+static void RemoveSocketAndExit(int sig) {
+    unlink(socketPath);
+    _exit(0);
+}
+
+/* Reads until the client shuts down its writing side. Fails on a read
+ * error, which includes the timeout set on the socket, and once more
+ * than MaxRequestBytes have arrived.
+ */
+static bool ReadAll(int fd, std::string &data) {
+    char buf[16384];
+    for (;;) {
+      ssize_t n = read(fd, buf, sizeof(buf));
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) return false;
+      if (n == 0) return true;
+      data.append(buf, n);
+      if (data.size() > MaxRequestBytes) return false;
+    }
+}
+
+static bool WriteAll(int fd, const char *p, size_t len) {
+    while (len > 0) {
+      ssize_t n = write(fd, p, len);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      p += n;
+      len -= n;
+    }
+    return true;
+}
+
+static void HandleRequest(int fd, const Options &defaults, WorkerState *worker) {
+    std::string request;
+    if (!ReadAll(fd, request))
+      return;
+    size_t eol = request.find('\n');
+    std::string optionLine = request.substr(0, eol);
+    llvm::StringRef source;
+    if (eol != std::string::npos)
+      source = llvm::StringRef(request).substr(eol + 1);
+
+    // the words must outlive opts, which points into them for -mcpu=
+    Options opts = defaults;
+    Diagnostics diags;
+    std::vector<std::string> words;
+    std::istringstream in(optionLine);
+    std::string word;
+    while (in >> word)
+      words.push_back(word);
+    for (int i = 0; i < words.size(); i++) {
+      if (!ParseCodegenOption(words[i].c_str(), opts)) {
+        diags.messages += "\n*** Error.\n*** Unknown option '" + words[i] + "'\n\n";
+        diags.numErrors++;
+      }
+    }
+
+    llvm::SmallVector<char, 0> output;
+    bool ok = false;
+    if (diags.numErrors == 0) {
+      llvm::raw_svector_ostream os(output);
+      ok = CompileSource(source, opts, os, &diags, worker);
+    }
+
+    const char *data = ok ? output.data() : diags.messages.data();
+    size_t len = ok ? output.size() : diags.messages.size();
+    char header[64];
+    snprintf(header, sizeof(header), "%s %zu\n", ok ? "ok" : "error", len);
+    if (WriteAll(fd, header, strlen(header)))
+      WriteAll(fd, data, len);
+}
+
+static void ServeConnections(int listenFd, const Options *opts) {
+    WorkerState worker;
+    {
+      Options warmup = *opts;
+      warmup.cacheDir = NULL;
+      Diagnostics diags;
+      llvm::SmallVector<char, 0> output;
+      llvm::raw_svector_ostream os(output);
+      CompileSource(WarmupSource, warmup, os, &diags, &worker);
+    }
+    struct timeval timeout = { RequestTimeout, 0 };
+    for (;;) {
+      int fd = accept(listenFd, NULL, NULL);
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED)
+          continue;
+        ReportError::Formatted(NULL, "Cannot accept connection: %s", strerror(errno));
+        return;
+      }
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      HandleRequest(fd, *opts, &worker);
+      close(fd);
+    }
+}
+
+int Serve(const char *path, const Options &opts) {
+    if (strlen(path) >= sizeof(socketPath)) {
+      ReportError::Formatted(NULL, "Socket path '%s' is too long", path);
+      return 1;
+    }
+    strcpy(socketPath, path);
+
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+
+    // only replace a socket left behind by an earlier server
+    struct stat st;
+    if (stat(path, &st) == 0) {
+      if (!S_ISSOCK(st.st_mode)) {
+        ReportError::Formatted(NULL, "'%s' exists and is not a socket", path);
+        return 1;
+      }
+      unlink(path);
+    }
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (listenFd < 0 ||
+        bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        chmod(path, 0600) != 0 ||
+        listen(listenFd, SOMAXCONN) != 0) {
+      ReportError::Formatted(NULL, "Cannot listen on '%s': %s", path, strerror(errno));
+      if (listenFd >= 0) close(listenFd);
+      return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);   // clients may hang up before the answer
+    signal(SIGINT, RemoveSocketAndExit);
+    signal(SIGTERM, RemoveSocketAndExit);
+
+    int workers = opts.jobs > 0 ? opts.jobs : std::thread::hardware_concurrency();
+    if (workers < 1) workers = 1;
+    std::vector<std::thread> pool;
+    for (int j = 1; j < workers; j++)
+      pool.push_back(std::thread(ServeConnections, listenFd, &opts));
+    ServeConnections(listenFd, &opts);
+    for (int j = 0; j < pool.size(); j++)
+      pool[j].join();
+
+    close(listenFd);
+    unlink(path);
+    return 1;
+}
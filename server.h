@@ -0,0 +1,43 @@
+/* File: server.h
+ * --------------
+ * This file declares the compile server started with glc --serve <path>.
+ * The server listens on a Unix domain socket at path and keeps one warm
+ * process for tools that compile many small shaders, so they pay neither
+ * process startup nor LLVM initialization per shader: the targets are
+ * registered once, and each worker thread keeps its LLVMContext (with the
+ * built-in types) and TargetMachines across requests (see WorkerState in
+ * driver.h). The optimization pipeline is still built per request.
+ *
+ * Protocol: a client connects and sends one request, a line of options
+ * followed by the source text, then shuts down its writing side:
+ *
+ *     -O2 -emit=obj -mcpu=native\n
+ *     <source>
+ *
+ * The options line may be empty; only -O<n>, -emit=, -mcpu= and -no-ssa
+ * are accepted there, anything not given is taken from the server's
+ * command line (which also supplies --cache-dir). A request may be at most
+ * MaxRequestBytes long and must arrive within RequestTimeout seconds,
+ * or the connection is dropped. The server answers with
+ *
+ *     ok <n>\n<n bytes of bitcode, assembly or object code>
+ *     error <n>\n<n bytes of diagnostics, worded as glc prints them>
+ *
+ * and closes the connection. Requests are compiled concurrently, each in
+ * its own CompilationContext.
+ */
+
+#ifndef _H_server
+#define _H_server
+
+#include "options.h"
+
+/* Function: Serve()
+ * -----------------
+ * Serves compile requests on the socket at path on opts.jobs worker
+ * threads (one per core unless -j is given). Returns only if the socket
+ * cannot be set up, with a non-zero status.
+ */
+int Serve(const char *path, const Options &opts);
+
+#endif
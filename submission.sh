@@ -49,6 +49,27 @@ then
         cp symtable.h $pid/
 	cp irgen.cc $pid/
 	cp irgen.h $pid/
+	cp options.h $pid/
+	cp jit.cc $pid/
+	cp jit.h $pid/
+	cp driver.cc $pid/
+	cp driver.h $pid/
+	cp context.cc $pid/
+	cp context.h $pid/
+	cp glc.cc $pid/
+	cp glc.h $pid/
+	cp cache.cc $pid/
+	cp cache.h $pid/
+	cp server.cc $pid/
+	cp server.h $pid/
+	cp timing.cc $pid/
+	cp timing.h $pid/
+	cp trace.cc $pid/
+	cp trace.h $pid/
+	cp arena.cc $pid/
+	cp arena.h $pid/
+	cp atom.cc $pid/
+	cp atom.h $pid/
 
 	zip -r $pid.zip $pid/*
 else 
@@ -3,46 +3,76 @@
  *
  */
 
-#include <sstream>
-#include <iostream>
 #include "symtable.h"
-#include <string>
+#include "trace.h"
+
 Symtable::Symtable() : current(0) {
-  list = vector<map<string,llvm::Value*> >();
-  list.push_back(map<string,llvm::Value*>());
 }
 Symtable::~Symtable() {}
 
-bool
-Symtable::Lookup(string name) {
-  map<string,llvm::Value*>::iterator it;
-  it = list.at(current).find(name);
-  if (it != list.at(current).end())
-    return true;
-  return false;
-}
-llvm::Value*
-Symtable::Lookup(int i, string name) {
-  map<string,llvm::Value*>::iterator it;
-  it = list.at(i).find(name);
-  if (it != list.at(current).end()) {
-    return list.at(i).find(name)->second;
-  }
-  return NULL;
+VarDecl*
+Symtable::Lookup(Atom name) {
+  llvm::DenseMap<Atom,int>::iterator it = innermost.find(name);
+  if (it == innermost.end())
+    return NULL;
+  return bindings[it->second].decl;
+}
+VarDecl*
+Symtable::LookupInScope(Atom name) {
+  llvm::DenseMap<Atom,int>::iterator it = innermost.find(name);
+  if (it == innermost.end() || bindings[it->second].scope != current)
+    return NULL;
+  return bindings[it->second].decl;
+}
+FnDecl*
+Symtable::LookupFunction(Atom name) {
+  llvm::DenseMap<Atom,FnDecl*>::iterator it = functions.find(name);
+  return it == functions.end() ? NULL : it->second;
+}
+void
+Symtable::InsertFunction(Atom name, FnDecl* decl) {
+  functions.insert(std::make_pair(name, decl));
 }
+/* A name declared twice in one scope keeps its first binding (the
+ * conflict is reported by VarDecl::Resolve, see LookupInScope).
+ */
 void
-Symtable::Insert(string name, llvm::Value* val) {
-  list.at(current).insert(pair<string,llvm::Value*>(name,val));
+Symtable::Insert(Atom name, VarDecl* decl) {
+  std::pair<llvm::DenseMap<Atom,int>::iterator,bool> res =
+    innermost.insert(std::make_pair(name, (int)bindings.size()));
+  Binding b = { name, decl, current, -1 };
+  if (!res.second) {
+    if (bindings[res.first->second].scope == current)
+      return;
+    b.shadowed = res.first->second;
+    res.first->second = bindings.size();
+  }
+  bindings.push_back(b);
 }
 
 void
 Symtable::Push() {
-  list.push_back(map<string,llvm::Value*>());
+  scopeMarks.push_back(bindings.size());
   current++;
+  if (IsTracing())
+    scopeStart.push_back(TraceNow());
 }
 
 void
 Symtable::Pop() {
-  list.pop_back();
+  int mark = scopeMarks.back();
+  scopeMarks.pop_back();
+  while ((int)bindings.size() > mark) {
+    Binding &b = bindings.back();
+    if (b.shadowed >= 0)
+      innermost[b.name] = b.shadowed;
+    else
+      innermost.erase(b.name);
+    bindings.pop_back();
+  }
   current--;
+  if (!scopeStart.empty()) {
+    AddTraceEvent("symtab", "scope", scopeStart.back());
+    scopeStart.pop_back();
+  }
 }
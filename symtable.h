@@ -2,36 +2,55 @@
  * File: symtable.h
  * ----------- 
  *  Header file for Symbol table implementation.
+ *
+ *  The table is used by the name resolution pass (see Program::Resolve)
+ *  to bind each variable use to the VarDecl in scope and each call to
+ *  its FnDecl. Functions are all declared at file scope, so they are
+ *  kept in a map of their own that scopes don't touch.
+ *
+ *  All scopes share one hash table (an llvm::DenseMap, open addressing)
+ *  from a name to its innermost binding, so a lookup costs the same at
+ *  any nesting depth. A binding that shadows an outer one keeps the
+ *  index of the binding it hides. The bindings are kept in the order they
+ *  were made, which doubles as the undo log: Pop() walks back to where
+ *  the scope started and puts the shadowed bindings back in the table.
  */
 #ifndef _SYMTABLE_H_
 #define _SYMTABLE_H_
 
 #include <iostream>
-#include <map>
 #include <vector>
-#include <string>
-#include <list>
 #include "irgen.h"
 #include "ast_type.h"
 #include "ast_decl.h"
+#include "atom.h"
+#include "llvm/ADT/DenseMap.h"
 using namespace std;
+
 class Symtable {
 public:
   Symtable();
   ~Symtable();
-  bool Lookup(string);
-  llvm::Value* Lookup(int, string);
-  void Insert(string,llvm::Value*);
+  VarDecl* Lookup(Atom);          // innermost binding, NULL if none
+  VarDecl* LookupInScope(Atom);   // binding in the current scope only
+  void Insert(Atom,VarDecl*);
+  FnDecl* LookupFunction(Atom);   // NULL if none
+  void InsertFunction(Atom,FnDecl*);
   void Push();
   void Pop();
   int GetCurrentIndex() {return current;}
-  vector<map<string,llvm::Value*> >& GetVector() {return list;}
-  map<string,llvm::Value*>& GetMap() {return list.at(current);}
-  map<string,llvm::Value*>& GetGlobalMap() {return list.at(0);}
-  map<string,llvm::Value*>& GetIndexMap(int i) {return list.at(i);}
-  map<string,llvm::Value*>& GetPrevMap() {return list.at(current-1);}
 protected:
-  vector<map<string,llvm::Value*> >list;
+  struct Binding {
+    Atom name;
+    VarDecl *decl;
+    int scope;
+    int shadowed;     // index of the binding this one hides, -1 if none
+  };
+  llvm::DenseMap<Atom,int> innermost;  // name -> index in bindings
+  vector<Binding> bindings;            // in order made, the undo log
+  vector<int> scopeMarks;              // size of bindings at each Push()
+  llvm::DenseMap<Atom,FnDecl*> functions;
+  vector<double> scopeStart;  // trace timestamps of the open scopes
   int current;
 };
 #endif // _SYMTABLE_H_
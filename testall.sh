@@ -14,13 +14,13 @@ make &>/dev/null
 echo "Compiling Done" 
 if cd tests; then
 	cp ../glc ./
-        chmod +x gli
-	if (! [ -f ../gli ]); then 
-		echo "gli is not present"
-		exit 1
-	fi 	
-	cp ../gli ./
-	chmod +x gli	
+	# without gli, run each test in-process with glc --run
+	if [ -f ../gli ]; then
+		cp ../gli ./
+		chmod +x gli
+	else
+		echo "gli is not present, using glc --run"
+	fi
 else 
 	echo "Could not change diretcory to samples ..Quiting 	"
 	exit 1
@@ -32,9 +32,13 @@ if [ -f glc ]; then
                 testbasename=${testid%.glsl}
                 rm -rf "$testbasename".ll
 		rm -rf "$testbasename".bc
-                ./glc <$testname > $testbasename.bc
-		llvm-dis $testbasename.bc
-                ./gli $testbasename.bc > $testbasename.myout
+                if [ -f gli ]; then
+                        ./glc <$testname > $testbasename.bc
+                        llvm-dis $testbasename.bc
+                        ./gli $testbasename.bc > $testbasename.myout
+                else
+                        ./glc --run $testbasename.dat <$testname > $testbasename.myout
+                fi
         done
         for testname in $PWD/*.out
         do
@@ -43,8 +47,8 @@ if [ -f glc ]; then
                 if cmp -s "$testbasename.myout" "$testbasename.out"
                 then
                         echo "$testbasename Passed..Cleaning debug files for this test"
-			rm $testbasename.ll
-			rm $testbasename.bc
+			rm -f $testbasename.ll
+			rm -f $testbasename.bc
                 else
                         echo "$testbasename Failed"
                 fi
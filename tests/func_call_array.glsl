@@ -0,0 +1,21 @@
+int n;
+
+float scale(float x, float k)
+{
+   return x * k;
+}
+
+float callarray()
+{
+   float a[3];
+   vec2 v;
+   int i;
+
+   for (i = 0; i < 3; i++)
+     a[i] = scale(2.0, 1.5);
+   a[1] += 1.0;
+   v.y = a[1];
+   v.x = n > 1 ? a[0] : 0.0;
+
+   return v.x + v.y + a[2];
+}
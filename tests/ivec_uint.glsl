@@ -0,0 +1,17 @@
+ivec3 a;
+uint u;
+uint d;
+uint one;
+
+uint intvec()
+{
+   ivec3 t;
+   uint q;
+
+   t = a * 2 + a;
+   q = u / d;
+   if (t == a * 3 && t.x + t.y * t.z == -87)
+     q = q + one;
+
+   return q;
+}
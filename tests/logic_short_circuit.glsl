@@ -0,0 +1,10 @@
+int x;
+
+int arith()
+{
+  bool t;
+  t = (x > 0) && (++x > 1);
+  t = t || (x++ >= 0);
+  t = t || (++x > 0);
+  return x;
+}
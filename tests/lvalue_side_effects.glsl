@@ -0,0 +1,19 @@
+float lvalueonce()
+{
+   float a[4];
+   int i;
+
+   a[0] = 1.0;
+   a[1] = 2.0;
+   a[2] = 4.0;
+   a[3] = 8.0;
+
+   i = 0;
+   a[i++] += 10.0;
+   a[i++]++;
+   ++a[i++];
+   if (i != 3)
+     return 0.0;
+
+   return a[0] + a[1] + a[2] + a[3];
+}
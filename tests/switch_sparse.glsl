@@ -0,0 +1,16 @@
+int a;
+float switchtest()
+{
+   float f;
+
+   switch( a ) {
+     case 1: f  = 1.0; break;
+     case 10: f  = 10.0; break;
+     case 100: f  = 100.0; break;
+     case 1000: f = 1000.0;
+     case 10000: f = f + 1.0; break;
+     default: f = 3.0; break;
+   }
+
+   return f;
+}
@@ -0,0 +1,15 @@
+vec3 a;
+vec3 b;
+float s;
+
+float vecmath()
+{
+   vec3 t;
+
+   t = a * s;
+   t -= b;
+   if (t == a)
+     return 0.0;
+
+   return t.x + t.y * t.z;
+}
@@ -0,0 +1,142 @@
+/* File: timing.cc
+ * ---------------
+ * Implementation of the phase timer and the time report.
+ */
+
+#include "timing.h"
+#include <chrono>
+#include <time.h>
+#include <sys/resource.h>
+
+thread_local uint64_t numAllocations = 0;
+thread_local uint64_t allocatedBytes = 0;
+
+double WallTime() {
+    return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double ThreadCpuTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+long PeakRSS() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;   // KB on Linux
+}
+
+TimeReport::TimeReport() :
+    depth(0),
+    scanTime(0),
+    scanTokens(0)
+{
+    startWall = WallTime();
+    startCpu = ThreadCpuTime();
+    startAllocations = numAllocations;
+    startBytes = allocatedBytes;
+}
+
+TimeReport::Entry TimeReport::Total() {
+    Entry total;
+    total.phase = "total";
+    total.depth = 0;
+    total.wall = WallTime() - startWall;
+    total.cpu = ThreadCpuTime() - startCpu;
+    total.allocations = numAllocations - startAllocations;
+    total.bytes = allocatedBytes - startBytes;
+    total.peakRSS = PeakRSS();
+    return total;
+}
+
+static void PrintRow(FILE *out, const std::string &name, int depth, double wall,
+                     double cpu, uint64_t allocations, uint64_t bytes, long rss) {
+    fprintf(out, "  %*s%-*s %10.3f %10.3f %10llu %12llu %10ld\n", 2*depth, "",
+            28 - 2*depth, name.c_str(), wall * 1000, cpu * 1000,
+            (unsigned long long)allocations, (unsigned long long)bytes, rss);
+}
+
+void TimeReport::Print(FILE *out) {
+    Entry total = Total();
+    flockfile(out);   // one report at a time from batch workers
+    fprintf(out, "===%s===\n", std::string(80, '-').c_str());
+    fprintf(out, "%*s\n", 48, "glc time report");
+    fprintf(out, "===%s===\n", std::string(80, '-').c_str());
+    fprintf(out, "  %-28s %10s %10s %10s %12s %10s\n", "Phase", "Wall (ms)",
+            "CPU (ms)", "Allocs", "Bytes", "RSS (KB)");
+    for (int i = 0; i < entries.size(); i++) {
+      const Entry &e = entries[i];
+      PrintRow(out, e.function.empty() ? e.phase : e.function, e.depth,
+               e.wall, e.cpu, e.allocations, e.bytes, e.peakRSS);
+      if (e.phase == "parse")
+        fprintf(out, "  %*s%-*s %10.3f %10s %10s %12s %10s   (%d tokens)\n",
+                2*(e.depth+1), "", 28 - 2*(e.depth+1), "scan",
+                scanTime * 1000, "-", "-", "-", "-", scanTokens);
+    }
+    PrintRow(out, total.phase, 0, total.wall, total.cpu, total.allocations,
+             total.bytes, total.peakRSS);
+    fflush(out);
+    funlockfile(out);
+}
+
+static void PrintJSONEntry(FILE *out, const char *phase, const std::string &function,
+                           double wall, double cpu, uint64_t allocations,
+                           uint64_t bytes, long rss) {
+    fprintf(out, "    {\"phase\": \"%s\", ", phase);
+    if (!function.empty())
+      fprintf(out, "\"function\": \"%s\", ", function.c_str());
+    fprintf(out, "\"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"allocations\": %llu, "
+            "\"bytes\": %llu, \"peak_rss_kb\": %ld}", wall * 1000, cpu * 1000,
+            (unsigned long long)allocations, (unsigned long long)bytes, rss);
+}
+
+void TimeReport::PrintJSON(FILE *out) {
+    Entry total = Total();
+    flockfile(out);
+    fprintf(out, "{\n  \"phases\": [\n");
+    for (int i = 0; i < entries.size(); i++) {
+      const Entry &e = entries[i];
+      PrintJSONEntry(out, e.phase.c_str(), e.function, e.wall, e.cpu,
+                     e.allocations, e.bytes, e.peakRSS);
+      fprintf(out, ",\n");
+    }
+    PrintJSONEntry(out, total.phase.c_str(), "", total.wall, total.cpu,
+                   total.allocations, total.bytes, total.peakRSS);
+    fprintf(out, "\n  ],\n  \"scan\": {\"wall_ms\": %.3f, \"tokens\": %d}\n}\n",
+            scanTime * 1000, scanTokens);
+    fflush(out);
+    funlockfile(out);
+}
+
+PhaseTimer::PhaseTimer(TimeReport *r, const char *phase, const char *function) :
+    span(phase, function ? function : phase),
+    report(r)
+{
+    if (report == NULL)
+      return;
+    TimeReport::Entry entry;
+    entry.phase = phase;
+    entry.function = function ? function : "";
+    entry.depth = report->depth++;
+    index = report->entries.size();
+    report->entries.push_back(entry);
+
+    wall = WallTime();
+    cpu = ThreadCpuTime();
+    allocations = numAllocations;
+    bytes = allocatedBytes;
+}
+
+PhaseTimer::~PhaseTimer() {
+    if (report == NULL)
+      return;
+    TimeReport::Entry &entry = report->entries[index];
+    entry.wall = WallTime() - wall;
+    entry.cpu = ThreadCpuTime() - cpu;
+    entry.allocations = numAllocations - allocations;
+    entry.bytes = allocatedBytes - bytes;
+    entry.peakRSS = PeakRSS();
+    report->depth--;
+}
@@ -0,0 +1,89 @@
+/* File: timing.h
+ * --------------
+ * This file defines the phase timer behind -d time-report. Each phase of
+ * a compilation (parsing, with the time spent in the scanner broken out,
+ * Emit of the whole program and of every function, the optimization
+ * pipeline and writing the output) is measured for wall time, CPU time of
+ * the compiling thread, the number and size of the allocations made and
+ * the peak resident set size of the process when the phase ended.
+ *
+ * The report belongs to the CompilationContext and is printed to stderr
+ * when the context is destroyed: as a table with -d time-report, as JSON
+ * with -d time-report-json (both keys may be given).
+ */
+
+#ifndef _H_timing
+#define _H_timing
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "trace.h"
+
+// Allocations made by operator new on this thread, counted by the
+// replacement operators in main.cc (they stay 0 in libglc)
+extern thread_local uint64_t numAllocations;
+extern thread_local uint64_t allocatedBytes;
+
+double WallTime();        // seconds on a monotonic clock
+double ThreadCpuTime();   // CPU seconds used by the calling thread
+long PeakRSS();           // peak resident set size of the process in KB
+
+class TimeReport
+{
+  public:
+    TimeReport();
+
+    // Called by the scanner for every token; kept apart from the phases
+    // since scanning is interleaved with parsing
+    void AddScanTime(double seconds) { scanTime += seconds; scanTokens++; }
+
+    void Print(FILE *out);
+    void PrintJSON(FILE *out);
+
+  protected:
+    friend class PhaseTimer;
+
+    struct Entry {
+      std::string phase;
+      std::string function;   // empty unless the phase is per function
+      int depth;              // nesting level of the phase
+      double wall, cpu;
+      uint64_t allocations, bytes;
+      long peakRSS;
+    };
+
+    Entry Total();
+
+    std::vector<Entry> entries;   // in the order the phases started
+    int depth;
+    double scanTime;
+    int scanTokens;
+    double startWall, startCpu;
+    uint64_t startAllocations, startBytes;
+};
+
+/* Class: PhaseTimer
+ * -----------------
+ * Measures the phase that lasts as long as the timer is in scope and
+ * records it in report. Does nothing if report is NULL, i.e. unless a
+ * time report was asked for. The phase is also a span of the trace
+ * written with --trace-out (see trace.h), named after the function if
+ * one is given.
+ */
+class PhaseTimer
+{
+  public:
+    PhaseTimer(TimeReport *report, const char *phase, const char *function = NULL);
+    ~PhaseTimer();
+
+  private:
+    TraceSpan span;
+    TimeReport *report;
+    int index;
+    double wall, cpu;
+    uint64_t allocations, bytes;
+};
+
+#endif
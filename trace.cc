@@ -0,0 +1,131 @@
+/* File: trace.cc
+ * --------------
+ * Implementation of the event tracer. Events are kept in memory, guarded
+ * by a lock since batch workers record them concurrently, and written in
+ * the Trace Event Format ("X" complete events plus thread names).
+ */
+
+#include "trace.h"
+#include "timing.h"   // for WallTime
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+
+struct TraceEvent {
+    const char *category;
+    std::string name;
+    int tid;
+    double start, duration;   // microseconds
+    int line;
+};
+
+static std::atomic<bool> tracing(false);
+static std::string tracePath;
+static double traceStart;
+static std::mutex traceLock;
+static std::vector<TraceEvent> events;
+static std::vector<std::pair<int, std::string> > threadNames;
+
+static std::atomic<int> nextThreadId(1);
+static thread_local int threadId = 0;
+
+static int ThreadId() {
+    if (threadId == 0)
+      threadId = nextThreadId++;
+    return threadId;
+}
+
+void StartTrace(const char *path) {
+    tracePath = path;
+    traceStart = WallTime();
+    tracing = true;
+}
+
+bool IsTracing() {
+    return tracing;
+}
+
+double TraceNow() {
+    return WallTime();
+}
+
+void AddTraceEvent(const char *category, const std::string &name,
+                   double start, int line) {
+    if (!tracing)
+      return;
+    TraceEvent e;
+    e.category = category;
+    e.name = name;
+    e.tid = ThreadId();
+    e.start = (start - traceStart) * 1e6;
+    e.duration = (WallTime() - start) * 1e6;
+    e.line = line;
+    std::lock_guard<std::mutex> guard(traceLock);
+    events.push_back(e);
+}
+
+void SetTraceThreadName(const std::string &name) {
+    if (!tracing)
+      return;
+    std::lock_guard<std::mutex> guard(traceLock);
+    threadNames.push_back(std::make_pair(ThreadId(), name));
+}
+
+static std::string Escape(const std::string &s) {
+    std::string out;
+    for (int i = 0; i < s.size(); i++) {
+      if (s[i] == '"' || s[i] == '\\') out += '\\';
+      if ((unsigned char)s[i] >= ' ') out += s[i];
+    }
+    return out;
+}
+
+void FinishTrace() {
+    if (!tracing)
+      return;
+    tracing = false;
+    FILE *fp = fopen(tracePath.c_str(), "w");
+    if (fp == NULL) {
+      fprintf(stderr, "*** Cannot write trace to '%s'\n", tracePath.c_str());
+      return;
+    }
+    std::lock_guard<std::mutex> guard(traceLock);
+    int pid = getpid();
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    const char *separator = "\n";
+    for (int i = 0; i < threadNames.size(); i++) {
+      fprintf(fp, "%s{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": %d, \"tid\": %d, "
+              "\"args\": {\"name\": \"%s\"}}", separator, pid, threadNames[i].first,
+              Escape(threadNames[i].second).c_str());
+      separator = ",\n";
+    }
+    for (int i = 0; i < events.size(); i++) {
+      const TraceEvent &e = events[i];
+      fprintf(fp, "%s{\"ph\": \"X\", \"cat\": \"%s\", \"name\": \"%s\", \"pid\": %d, "
+              "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f", separator, e.category,
+              Escape(e.name).c_str(), pid, e.tid, e.start, e.duration);
+      if (e.line > 0)
+        fprintf(fp, ", \"args\": {\"line\": %d}", e.line);
+      fprintf(fp, "}");
+      separator = ",\n";
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+}
+
+TraceSpan::TraceSpan(const char *c, const char *n, int l) :
+    category(c),
+    name(n),
+    line(l),
+    start(0)
+{
+    if (tracing)
+      start = WallTime();
+}
+
+TraceSpan::~TraceSpan() {
+    if (start != 0)
+      AddTraceEvent(category, name, start, line);
+}
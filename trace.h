@@ -0,0 +1,46 @@
+/* File: trace.h
+ * -------------
+ * This file defines the event tracer behind --trace-out=<file>. While
+ * tracing, spans of compiler work (the phases, Emit of every function,
+ * the lowering of loops and ifs, symbol table scopes, batch workers) are
+ * collected with the thread they ran on and written at exit as Chrome
+ * trace JSON, which chrome://tracing and Perfetto show as a flame view.
+ * When tracing is off a span costs one test of a flag.
+ */
+
+#ifndef _H_trace
+#define _H_trace
+
+#include <string>
+
+void StartTrace(const char *path);   // collect events until FinishTrace()
+void FinishTrace();                  // write them to the path given
+bool IsTracing();
+double TraceNow();                   // timestamp for AddTraceEvent
+
+// Records a span that started at start (a TraceNow() value) and ends now
+// on the calling thread. line, if not 0, is the source line it covers.
+void AddTraceEvent(const char *category, const std::string &name,
+                   double start, int line = 0);
+
+// Names the calling thread in the trace ("main", "worker 2", ...)
+void SetTraceThreadName(const std::string &name);
+
+/* Class: TraceSpan
+ * ----------------
+ * Records a span for as long as it is in scope.
+ */
+class TraceSpan
+{
+  public:
+    TraceSpan(const char *category, const char *name, int line = 0);
+    ~TraceSpan();
+
+  private:
+    const char *category;
+    const char *name;
+    int line;
+    double start;
+};
+
+#endif
@@ -5,6 +5,7 @@
  */
 
 #include "utility.h"
+#include "options.h"
 #include <stdarg.h>
 #include <string.h>
 #include <vector>
@@ -13,6 +14,8 @@ using std::vector;
 static vector<const char*> debugKeys;
 static const int BufferSize = 2048;
 
+Options compilerOptions;
+
 void Failure(const char *format, ...) {
   va_list args;
   char errbuf[BufferSize];
@@ -58,19 +61,76 @@ void PrintDebug(const char *key, const char *format, ...) {
   printf("+++ (%s): %s%s", key, buf, buf[strlen(buf)-1] != '\n'? "\n" : "");
 }
 
-void ParseCommandLine(int argc, char *argv[]) {
-  if (argc == 1)
-    return;
-  
-  if (strcmp(argv[1], "-d") != 0) { // first arg is not -d
-    printf("Incorrect Use:   ");
-    for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
-    printf("\n");
-    printf("Correct Usage:   -d <debug-key-1> <debug-key-2> ... \n");
-    exit(2);
-  }
+static void PrintUsage(int argc, char *argv[]) {
+  printf("Incorrect Use:   ");
+  for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
+  printf("\n");
+  printf("Correct Usage:   [-O0|-O1|-O2|-O3] [-emit=bc|asm|obj] [-mcpu=<cpu>|native] [-no-ssa]\n"
+         "                 [--cache-dir=<dir> [--cache-size=<MB>]] [--trace-out=<file>]\n"
+         "                 [--run <file.dat> | -j <N> <file.glsl> ... |\n"
+         "                  --serve <socket> [-j <N>]]\n"
+         "                 [-d <debug-key>[,<debug-key> ...]]\n");
+  exit(2);
+}
 
-  for (int i = 2; i < argc; i++)
-    SetDebugForKey(argv[i], true);
+bool ParseCodegenOption(const char *arg, Options &opts) {
+  if (arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3' &&
+      arg[3] == '\0') {
+    opts.optLevel = arg[2] - '0';
+  } else if (strcmp(arg, "-emit=bc") == 0) {
+    opts.emit = EmitBitcode;
+  } else if (strcmp(arg, "-emit=asm") == 0) {
+    opts.emit = EmitAssembly;
+  } else if (strcmp(arg, "-emit=obj") == 0) {
+    opts.emit = EmitObject;
+  } else if (strncmp(arg, "-mcpu=", 6) == 0) {
+    opts.cpu = arg + 6;
+  } else if (strcmp(arg, "-no-ssa") == 0) {
+    opts.buildSSA = false;
+  } else {
+    return false;
+  }
+  return true;
 }
 
+void ParseCommandLine(int argc, char *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-d") == 0) {
+      // one key, or several separated by commas: -d time-report,dumpAST
+      if (i + 1 == argc) PrintUsage(argc, argv);
+      for (char *key = strtok(argv[++i], ","); key != NULL; key = strtok(NULL, ","))
+        SetDebugForKey(key, true);
+    } else if (strcmp(argv[i], "--run") == 0) {
+      if (i + 1 == argc) PrintUsage(argc, argv);
+      compilerOptions.runData = argv[++i];
+    } else if (strncmp(argv[i], "--run=", 6) == 0) {
+      compilerOptions.runData = argv[i] + 6;
+    } else if (ParseCodegenOption(argv[i], compilerOptions)) {
+      // -O<n>, -emit=bc|asm|obj, -mcpu=<cpu> or -no-ssa
+    } else if (strcmp(argv[i], "--serve") == 0) {
+      if (i + 1 == argc) PrintUsage(argc, argv);
+      compilerOptions.servePath = argv[++i];
+    } else if (strncmp(argv[i], "--serve=", 8) == 0) {
+      compilerOptions.servePath = argv[i] + 8;
+    } else if (strcmp(argv[i], "-j") == 0) {
+      if (i + 1 == argc || atoi(argv[i+1]) <= 0) PrintUsage(argc, argv);
+      compilerOptions.jobs = atoi(argv[++i]);
+    } else if (strncmp(argv[i], "--cache-dir=", 12) == 0) {
+      compilerOptions.cacheDir = argv[i] + 12;
+    } else if (strncmp(argv[i], "--cache-size=", 13) == 0) {
+      if (atoi(argv[i] + 13) <= 0) PrintUsage(argc, argv);
+      compilerOptions.cacheSize = (uint64_t)atoi(argv[i] + 13) << 20;
+    } else if (strncmp(argv[i], "--trace-out=", 12) == 0) {
+      compilerOptions.traceOut = argv[i] + 12;
+    } else if (argv[i][0] != '-') {
+      compilerOptions.inputs.push_back(argv[i]);
+    } else {
+      PrintUsage(argc, argv);
+    }
+  }
+  if (compilerOptions.runData && !compilerOptions.inputs.empty())
+    PrintUsage(argc, argv);
+  if (compilerOptions.servePath &&
+      (compilerOptions.runData || !compilerOptions.inputs.empty()))
+    PrintUsage(argc, argv);
+}
@@ -76,11 +76,31 @@ bool IsDebugOn(const char *key);
 /**
  * Function: ParseCommandLine
  * --------------------------
- * Turn on the debugging flags from the command line.  Verifies that
- * first argument is -d, and then interpret all the arguments that follow
- * as being flags to turn on.
+ * Turn on the debugging flags and fill in compilerOptions (see options.h)
+ * from the command line.  The argument following -d is a debug key to
+ * turn on, or several separated by commas; --run <file.dat> asks
+ * the driver to execute the program instead of writing bitcode, -O<n>
+ * selects the optimization level, -emit=asm|obj native output and
+ * -mcpu=<cpu> (or native) the processor it is generated for, and
+ * --cache-dir=<dir> a directory of earlier output to reuse, bounded to
+ * --cache-size=<MB>; --trace-out=<file> writes a Chrome trace of the
+ * compilation. Arguments that are not options name source files to
+ * compile in one process on -j N workers instead of reading standard
+ * input, and --serve <socket> runs glc as a compile server (see server.h).
  */
 
 void ParseCommandLine(int argc, char *argv[]);
+
+/**
+ * Function: ParseCodegenOption
+ * ----------------------------
+ * Applies arg to opts if it is one of the options that select the code
+ * generated (-O<n>, -emit=, -mcpu=, -no-ssa) and returns true, false
+ * otherwise.
+ * Used for the command line and for the options of server requests.
+ */
+
+struct Options;
+bool ParseCodegenOption(const char *arg, Options &opts);
      
 #endif